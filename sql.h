@@ -34,8 +34,12 @@
 #define sql_assert   assert
 #define sql_check_nullptr(x)  sql_assert(NULL != x)
 void *sql_xmalloc(size_t s);
+void *sql_xrealloc(void *p, size_t s);
 void sql_xfree(void *p);
 char *sql_xstrdup(const char *s);
+size_t sql_parse_count(const char *opt, const char *s, size_t min, size_t max);
+size_t sql_unescape(char *dst, const char *src, size_t n);
+size_t sql_unhex(char *dst, const char *src, size_t n);
 
 extern int sql_be_quiet;
 
@@ -76,21 +80,72 @@ extern int sql_be_quiet;
 
 struct sql_context;
 
+/* Position eines Tokens in der Eingabe (in Bytes) */
+struct sql_location {
+  size_t first_byte;
+  size_t last_byte;
+}; /* struct sql_location */
+
+/* Bereich einer Anweisung in der Eingabe: [begin, end) */
+struct sql_range {
+  size_t begin;
+  size_t end;
+  size_t rows;
+}; /* struct sql_range */
+
 enum sql_column_type {
   sql_column_type_none,
   sql_column_type_int,
   sql_column_type_float,
-  sql_column_type_str
+  sql_column_type_str,
+  sql_column_type_decimal,
+  sql_column_type_date,
+  sql_column_type_datetime,
+  sql_column_type_timestamp,
+  sql_column_type_time,
+  sql_column_type_enum,
+  sql_column_type_blob
 }; /* enum sql_column_type */
 
-struct sql_column {
-  char  *name;
-  enum sql_column_type type;
+/* Zahl, wie sie in der Eingabe steht (SIZE >= SQL_NUMBER_SIZE: zu lang,
+ * TEXT enthält dann nur den Anfang)
+ */
+#define SQL_NUMBER_SIZE 96
+struct sql_number {
+  char   text[SQL_NUMBER_SIZE];
+  size_t size;
+}; /* struct sql_number */
+
+/* Zeichenkette mit Länge (darf Nullbytes enthalten) */
+struct sql_text {
+  const char *str;
+  size_t      size;
+}; /* struct sql_text */
+
+struct sql_value {
   union {
     long long   int_value;
     long double flt_value;
-    char       *str_value;
   }; /* values */
+  char  *str_value;
+  size_t str_size;
+  size_t str_capacity;
+  int    is_null;
+}; /* struct sql_value */
+
+struct sql_table;
+struct sql_pipeline;
+struct sql_writer;
+struct sql_stats;
+
+struct sql_column {
+  char  *name;
+  enum sql_column_type type;
+  int    is_unsigned;
+  /* Wird beim Anlegen der Spalte passend zum Typ gewählt */
+  void (*write)(FILE *out, const struct sql_value *v, const struct sql_table *t);
+  struct sql_value     value;
+  struct sql_stats    *stats;
   struct sql_column   *prev;
   struct sql_column   *next;
 }; /* struct sql_column */
@@ -98,15 +153,32 @@ struct sql_column {
 struct sql_column *sql_column_new(void);
 void sql_column_free(struct sql_column *p);
 void sql_column_set_name(struct sql_column *p, const char *name);
+void sql_column_set_type(struct sql_column *p, enum sql_column_type type);
+void sql_column_set_unsigned(struct sql_column *p);
+const char *sql_column_get_type_name(enum sql_column_type type);
 void sql_column_set_none(struct sql_column *p);
-void sql_column_set_int(struct sql_column *p, const long long x);
-void sql_column_set_float(struct sql_column *p, const long double x);
-void sql_column_set_string(struct sql_column *p, const char *x);
+void sql_column_set_null(struct sql_column *p);
+int sql_column_set_int(struct sql_column *p, const long long x);
+int sql_column_set_float(struct sql_column *p, const long double x);
+int sql_column_set_number(struct sql_column *p, const char *x, size_t n);
+int sql_column_set_text(struct sql_column *p, const char *x, size_t n);
+int sql_column_set_binary(struct sql_column *p, const char *x, size_t n);
+int sql_column_set_string(struct sql_column *p, const char *x);
 void sql_column_add_sibbling(struct sql_column *p, struct sql_column *q, int pos);
 void sql_column_del_sibbling(struct sql_column *p);
 struct sql_column *sql_column_get_first_sibbling(struct sql_column *p);
 struct sql_column *sql_column_get_last_sibbling(struct sql_column *p);
 
+/* Zeile einer Stichprobe (bereits formatiert) */
+struct sql_sample {
+  char   *data;
+  size_t  size;
+  size_t  row;
+  /* Rohwerte für die Spaltenstatistik */
+  char   *values;
+  size_t  values_size;
+}; /* struct sql_sample */
+
 struct sql_table {
   FILE              *out;
   char              *name;
@@ -118,25 +190,71 @@ struct sql_table {
   size_t             rows;
   struct  {
     int drop_data:1;
+    int is_descriptor:1;
   }; /* flags */
   char *float_fmt;
+  char *null_token;
+  struct sql_pipeline *pipeline;
+  struct sql_writer   *writer;
+  /* -- Streaming -- */
+  void              *zfile;
+  long long          zfile_flushed;
+  long long          zfile_finished;
+  int                zfile_fd;
+  size_t             unflushed_rows;
+  char              *stats_file;
+  /* -- Index -- */
+  struct sql_range   schema;
+  struct sql_range  *ranges;
+  size_t             num_ranges;
+  unsigned long long hash;
+  /* -- Übersprungene Anweisungen -- */
+  size_t             skipped_statements;
+  size_t             skipped_rows;
+  /* -- Stichprobe (Reservoir) -- */
+  struct sql_sample *samples;
+  size_t             num_samples;
+  size_t             sample_seen;
+  size_t             sample_slot;
+  FILE              *sample_out;
+  char              *sample_buffer;
+  size_t             sample_size;
 };
 
 struct sql_table *sql_table_new(void);
 void sql_table_free(struct sql_table *p);
 void sql_table_set_name(struct sql_table *p, const char *name);
 void sql_table_set_file(struct sql_table *p, const char *name);
+void sql_table_get_filename(const struct sql_table *p, const struct sql_context *q, char *buf, size_t n);
+void sql_table_get_stats_filename(const struct sql_table *p, const struct sql_context *q, char *buf, size_t n);
 void sql_table_open(struct sql_table *p, const struct sql_context *q);
 void sql_table_write_header(struct sql_table *p);
 void sql_table_write_types(struct sql_table *p);
 void sql_table_write_row(struct sql_table *p);
+void sql_table_write_sample(struct sql_table *p);
+void sql_table_add_stats(struct sql_table *p);
+void sql_table_flush(struct sql_table *p);
+void sql_table_write_block(struct sql_table *p, const void *data, size_t size);
+void sql_table_release(struct sql_table *p);
 void sql_table_close(struct sql_table *p);
 void sql_table_add_column(struct sql_table *p, struct sql_column *q);
+void sql_table_begin_range(struct sql_table *p, size_t begin);
+void sql_table_end_range(struct sql_table *p, size_t end);
 void sql_table_add_sibbling(struct sql_table *p, struct sql_table *q, int pos);
 void sql_table_del_sibbling(struct sql_table *p);
 struct sql_table *sql_table_get_first_sibbling(struct sql_table *p);
 struct sql_table *sql_table_get_last_sibbling(struct sql_table *p);
 
+/* Ausgabe einer Tabelle auf einen offenen Deskriptor (-F TABLE=FD). Alle
+ * Eingabedateien teilen sich die Einträge, der Header kommt nur einmal.
+ */
+struct sql_output {
+  const char *spec;
+  size_t      name_size;
+  int         fd;
+  int         has_header;
+}; /* struct sql_output */
+
 struct sql_context {
   struct {
     int compress:  1;
@@ -144,6 +262,10 @@ struct sql_context {
     int add_header:1;
     int add_types: 1;
     int auto_close:1;
+    int build_index:1;
+    int use_index: 1;
+    int skip_errors:1;
+    int column_stats:1;
   }; /* options */
   /* -- Tables -- */
   struct sql_table  *current_table;
@@ -154,19 +276,105 @@ struct sql_context {
   /* -- Sonstiges -- */
   char *source_file;
   char *float_fmt;
+  char *null_token;
   char *out_dir;
+  /* -- Tabellenauswahl -- */
+  char  **tables;
+  size_t  num_tables;
+  /* -- Eingabe -- */
+  size_t offset;
+  size_t input_left;
+  int    after_semicolon;
+  char  *buffer;
+  size_t buffer_size;
+  /* -- Übersprungene Anweisungen -- */
+  struct sql_table *insert_table;
+  int    in_insert;
+  size_t skip_depth;
+  size_t skip_rows;
+  size_t skipped_statements;
+  size_t skipped_rows;
+  /* -- Stichprobe -- */
+  double sample_rate;
+  size_t sample_rows;
+  unsigned long long seed;
+  int    in_values;
+  size_t row_depth;
+  /* -- Streaming -- */
+  size_t flush_rows;
+  size_t flush_bytes;
+  size_t flush_ms;
+  struct sql_output *outputs;
+  size_t num_outputs;
+  /* -- Inkrementelle Umwandlung -- */
+  char  *state_file;
 }; /* struct sql_context */
 
 struct sql_context sql_context_init(void);
 void sql_context_destroy(struct sql_context *p);
 void sql_context_add_table(struct sql_context *p, struct sql_table *q);
+struct sql_table *sql_context_get_table(struct sql_context *p, const char *name);
 void sql_context_lock_table(struct sql_context *p, const char *name);
 void sql_context_unlock_table(struct sql_context *p);
 // struct sql_column *sql_context_get_current_row(struct sql_context *p);
 void sql_context_write_current_row(struct sql_context *p);
+int sql_context_sample_row(struct sql_context *p);
+void sql_context_skip_row(struct sql_context *p);
+void sql_context_select_table(struct sql_context *p, char *name);
+int sql_context_is_selected(const struct sql_context *p, const char *name);
+void sql_context_add_output(struct sql_context *p, char *spec);
+struct sql_output *sql_context_get_output(const struct sql_context *p, const char *name);
+void sql_context_skip_statement(struct sql_context *p);
+void sql_context_report_skipped(const struct sql_context *p);
+char *sql_context_get_buffer(struct sql_context *p, size_t n);
+size_t sql_context_read_input(struct sql_context *p, FILE *in, char *buf, size_t n);
 
 struct sql_column *sql_context_get_current_column(struct sql_context *p);
 void sql_context_next_column(struct sql_context *p);
 
 // void sql_context_close_table(struct sql_context *ctx);
+
+void sql_index_get_filename(const struct sql_context *p, char *buf, size_t n);
+void sql_index_write(const struct sql_context *p, FILE *input, const char *filename);
+struct sql_table *sql_index_read(FILE *input, const char *filename);
+void sql_index_extract(struct sql_context *p, FILE *in, const char *filename);
+struct sql_table *sql_index_get_table(struct sql_table **first, const char *name);
+void sql_index_parse_table(struct sql_context *p, FILE *in, const struct sql_table *q, const char *filename);
+
+void sql_incremental_run(struct sql_context *p, FILE *in);
+
+void sql_writer_init(size_t threads, size_t buffers, size_t buffer_size, int direct);
+void sql_writer_shutdown(void);
+int sql_writer_enabled(void);
+FILE *sql_writer_open(const char *filename, const char *mode, struct sql_writer **writer);
+void sql_writer_release(struct sql_writer *p);
+
+struct sql_stats *sql_stats_new(enum sql_column_type type, int is_unsigned);
+void sql_stats_free(struct sql_stats *p);
+void sql_stats_add_null(struct sql_stats *p);
+void sql_stats_add_int(struct sql_stats *p, long long x);
+void sql_stats_add_float(struct sql_stats *p, long double x);
+void sql_stats_add_text(struct sql_stats *p, const char *x, size_t n);
+void sql_stats_add_value(struct sql_stats *p, const struct sql_value *v);
+size_t sql_stats_get_distinct(const struct sql_stats *p);
+void sql_stats_write(const struct sql_table *p, const char *filename);
+
+void sql_pipeline_init(size_t threads);
+void sql_pipeline_shutdown(void);
+int sql_pipeline_enabled(void);
+void sql_pipeline_write_row(struct sql_table *p);
+void sql_pipeline_close(struct sql_table *p);
+void sql_pipeline_flush(struct sql_table *p);
+void sql_pipeline_request_flush(void);
+
+void sql_flusher_init(size_t interval);
+void sql_flusher_shutdown(void);
+void sql_flusher_add(struct sql_table *p);
+void sql_flusher_remove(struct sql_table *p);
+
+/* Definiert in sql_scanner.l */
+void sql_scanner_skip_statement(void *scanner);
+
+/* Definiert in sql_parser.y */
+int sql_parse_range(struct sql_context *p, FILE *in, const struct sql_range *r);
 #endif /* _SQL_UTILS_H_ */
@@ -22,12 +22,21 @@
  */
 
 #include "sql.h"
+#include <errno.h>
 
 struct sql_column *sql_column_new(void)
 {
   struct sql_column *col = (struct sql_column*)sql_xmalloc(sizeof(struct sql_column));
   col->name = NULL;
   col->type = sql_column_type_none;
+  col->is_unsigned = 0;
+  col->write = NULL;
+  col->value.int_value = 0;
+  col->value.str_value = NULL;
+  col->value.str_size = 0;
+  col->value.str_capacity = 0;
+  col->value.is_null = 0;
+  col->stats = NULL;
   col->prev = NULL;
   col->next = NULL;
   return col;
@@ -38,6 +47,7 @@ void sql_column_free(struct sql_column *p)
   if(NULL != p) {
     sql_column_set_name(p, NULL);
     sql_column_set_none(p);
+    sql_stats_free(p->stats);
     sql_column_del_sibbling(p);
     sql_xfree(p);
   } /* if(NULL != p) */
@@ -55,93 +65,348 @@ void sql_column_set_name(struct sql_column *p, const char *name)
   p->name = sql_xstrdup(name);
 }
 
-void sql_column_set_none(struct sql_column *p)
+/* -- Ausgabe der Werte --
+ * Je Typ gibt es eine eigene Funktion, die beim Anlegen der Spalte gewählt
+ * wird. So muss beim Schreiben einer Zeile nicht nach dem Typ verzweigt
+ * werden.
+ */
+
+static void sql_column_write_int(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  char buf[24];
+  char *it = buf + sizeof(buf);
+  unsigned long long x = (0 > v->int_value) ? -(unsigned long long)v->int_value : (unsigned long long)v->int_value;
+
+  do {
+    *--it = '0' + (x % 10);
+    x /= 10;
+  } while(0 < x);
+
+  if(0 > v->int_value) {
+    *--it = '-';
+  } /* if(0 > v->int_value) */
+
+  fwrite_unlocked(it, 1, buf + sizeof(buf) - it, out);
+}
+
+static void sql_column_write_uint(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  char buf[24];
+  char *it = buf + sizeof(buf);
+  unsigned long long x = (unsigned long long)v->int_value;
+
+  do {
+    *--it = '0' + (x % 10);
+    x /= 10;
+  } while(0 < x);
+
+  fwrite_unlocked(it, 1, buf + sizeof(buf) - it, out);
+}
+
+static void sql_column_write_float(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  /* Das Format des Benutzers erwartet einen double */
+  fprintf(out, t->float_fmt, (double)v->flt_value);
+}
+
+static void sql_column_write_plain(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  /* Datum, Uhrzeit und Dezimalzahlen enthalten keine Sonderzeichen */
+  fwrite_unlocked(v->str_value, 1, v->str_size, out);
+}
+
+static void sql_column_write_text(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  const char *it = v->str_value;
+  const char *end = it + v->str_size;
+
+  for(; it != end; it += 1) {
+    if((',' == *it) || ('"' == *it) || ('\n' == *it) || ('\r' == *it)) {
+      break;
+    } /* if ... */
+  } /* for ... */
+
+  if(it == end) {
+    /* Keine Anführungszeichen nötig */
+    fwrite_unlocked(v->str_value, 1, v->str_size, out);
+    return;
+  } /* if(it == end) */
+
+  /* Anführungszeichen werden verdoppelt (RFC 4180) */
+  fputc_unlocked('"', out);
+  for(it = v->str_value; it != end; it += 1) {
+    if('"' == *it) {
+      fputc_unlocked('"', out);
+    } /* if('"' == *it) */
+    fputc_unlocked(*it, out);
+  } /* for ... */
+  fputc_unlocked('"', out);
+}
+
+static void sql_column_write_blob(FILE *out, const struct sql_value *v, const struct sql_table *t)
+{
+  static const char digits[] = "0123456789abcdef";
+  char buf[256];
+  size_t n = 0;
+  size_t i = 0;
+
+  for(; i < v->str_size; i += 1) {
+    const unsigned char c = (unsigned char)v->str_value[i];
+    buf[n++] = digits[c >> 4];
+    buf[n++] = digits[c & 0x0f];
+
+    if(sizeof(buf) == n) {
+      fwrite_unlocked(buf, 1, n, out);
+      n = 0;
+    } /* if(sizeof(buf) == n) */
+  } /* for ... */
+
+  fwrite_unlocked(buf, 1, n, out);
+}
+
+void sql_column_set_type(struct sql_column *p, enum sql_column_type type)
 {
   sql_check_nullptr(p);
 
-  switch(p->type) {
-    case sql_column_type_none:
+  switch(type) {
     case sql_column_type_int:
+      p->write = sql_column_write_int;
+      break;
     case sql_column_type_float:
-      /* Nix weiter */
+      p->write = sql_column_write_float;
+      break;
+    case sql_column_type_decimal:
+    case sql_column_type_date:
+    case sql_column_type_datetime:
+    case sql_column_type_timestamp:
+    case sql_column_type_time:
+      p->write = sql_column_write_plain;
       break;
     case sql_column_type_str:
-      sql_xfree(p->str_value);
+    case sql_column_type_enum:
+      p->write = sql_column_write_text;
+      break;
+    case sql_column_type_blob:
+      p->write = sql_column_write_blob;
       break;
     default:
       /* Ungültiger typ! */
-      sql_die_invalid_type(p);
-  }; /* switch(p->type) */
+      sql_die("Invalid type %i for column `%s'!", (int)type, (NULL != p->name) ? p->name : "<nil>");
+  }; /* switch(type) */
+
+  p->type = type;
+  p->value.int_value = 0;
+  p->value.str_size = 0;
+  p->value.is_null = 0;
+}
+
+void sql_column_set_unsigned(struct sql_column *p)
+{
+  sql_check_nullptr(p);
 
+  if(sql_column_type_int != p->type) {
+    /* Fließkomma- und Dezimalzahlen werden unverändert ausgegeben */
+    sql_warning("Ignoring `unsigned' for column `%s'!", p->name);
+    return;
+  } /* if ... */
+
+  /* BIGINT UNSIGNED reicht bis 2^64-1, der Wert wird als Bitmuster gehalten */
+  p->is_unsigned = 1;
+  p->write = sql_column_write_uint;
+}
+
+/* Liest eine Ganzzahl für die Spalte; liefert 0 bei Überlauf */
+static int sql_column_parse_int(const struct sql_column *p, const char *x, long long *v)
+{
+  errno = 0;
+
+  if(p->is_unsigned) {
+    /* strtoull() würde negative Werte stillschweigend umrechnen */
+    *v = (NULL != strchr(x, '-')) ? (errno = ERANGE, 0) : (long long)strtoull(x, NULL, 10);
+  } else {
+    *v = strtoll(x, NULL, 10);
+  } /* if(p->is_unsigned) */
+
+  /* Der Wert würde verfälscht */
+  return ERANGE != errno;
+}
+
+/* Übernimmt das Bitmuster einer Ganzzahl ohne Prüfung */
+static void sql_column_store_int(struct sql_column *p, const long long x)
+{
+  p->value.int_value = x;
+  p->value.is_null = 0;
+}
+
+const char *sql_column_get_type_name(enum sql_column_type type)
+{
+  switch(type) {
+    case sql_column_type_none:      return "none";
+    case sql_column_type_int:       return "int";
+    case sql_column_type_float:     return "float";
+    case sql_column_type_str:       return "string";
+    case sql_column_type_decimal:   return "decimal";
+    case sql_column_type_date:      return "date";
+    case sql_column_type_datetime:  return "datetime";
+    case sql_column_type_timestamp: return "timestamp";
+    case sql_column_type_time:      return "time";
+    case sql_column_type_enum:      return "enum";
+    case sql_column_type_blob:      return "blob";
+  }; /* switch(type) */
+
+  return NULL;
+}
+
+void sql_column_set_none(struct sql_column *p)
+{
+  sql_check_nullptr(p);
+
+  sql_xfree(p->value.str_value);
+  p->value.str_value = NULL;
+  p->value.str_size = 0;
+  p->value.str_capacity = 0;
+  p->value.is_null = 0;
   p->type = sql_column_type_none;
+  p->write = NULL;
 }
 
-void sql_column_set_int(struct sql_column *p, const long long x)
+void sql_column_set_null(struct sql_column *p)
+{
+  sql_check_nullptr(p);
+  p->value.is_null = 1;
+}
+
+/* Die Setter liefern 0, wenn der Wert nicht in die Spalte passt; der
+ * Aufrufer entscheidet, ob die Anweisung übersprungen wird.
+ */
+int sql_column_set_int(struct sql_column *p, const long long x)
 {
   sql_check_nullptr(p);
   
   switch(p->type) {
-    case sql_column_type_none:
     case sql_column_type_int:
+      if(p->is_unsigned && (0 > x)) {
+        /* Der Wert würde verfälscht */
+        return 0;
+      } /* if ... */
+      sql_column_store_int(p, x);
+      return 1;
     case sql_column_type_float:
-      /* Nix weiter */
-      break;
-    case sql_column_type_str:
-      /* Den Speicher frei geben */
-      sql_column_set_none(p);
-      break;
-    default:
-      /* Ungültiger typ! */
-      sql_die_invalid_type(p);
+      return sql_column_set_float(p, (long double)x);
+    default: {
+      /* Als Text übernehmen */
+      char buf[24];
+      const int l = snprintf(buf, sizeof(buf), "%lli", x);
+      return sql_column_set_text(p, buf, (size_t)l);
+      }
   }; /* switch(p->type) */
-
-  p->type = sql_column_type_int;
-  p->int_value = x;
 }
 
-void sql_column_set_float(struct sql_column *p, const long double x)
+int sql_column_set_float(struct sql_column *p, const long double x)
 {
   sql_check_nullptr(p);
   
   switch(p->type) {
-    case sql_column_type_none:
     case sql_column_type_int:
+      return sql_column_set_int(p, (long long)x);
     case sql_column_type_float:
-      /* Nix weiter */
-      break;
-    case sql_column_type_str:
-      /* Den Speicher frei geben */
-      sql_column_set_none(p);
-      break;
-    default:
-      /* Ungültiger typ! */
-      sql_die_invalid_type(p);
+      p->value.flt_value = x;
+      p->value.is_null = 0;
+      return 1;
+    default: {
+      /* Als Text übernehmen */
+      char buf[64];
+      const int l = snprintf(buf, sizeof(buf), "%Lg", x);
+      return sql_column_set_text(p, buf, (size_t)l);
+      }
   }; /* switch(p->type) */
-
-  p->type = sql_column_type_float;
-  p->flt_value = x;
 }
-void sql_column_set_string(struct sql_column *p, const char *x)
+
+int sql_column_set_number(struct sql_column *p, const char *x, size_t n)
 {
   sql_check_nullptr(p);
-  
+  sql_check_nullptr(x);
+
+  long long v = 0;
   switch(p->type) {
-    case sql_column_type_none:
     case sql_column_type_int:
+      if(!sql_column_parse_int(p, x, &v)) {
+        return 0;
+      } /* if(!sql_column_parse_int ... ) */
+      sql_column_store_int(p, v);
+      return 1;
     case sql_column_type_float:
-      /* Nix weiter */
-      break;
-    case sql_column_type_str:
-      /* Den Speicher frei geben */
-      sql_column_set_none(p);
-      break;
+      return sql_column_set_float(p, strtold(x, NULL));
     default:
+      /* Der Text bleibt erhalten, damit keine Stellen verloren gehen */
+      return sql_column_set_text(p, x, n);
+  }; /* switch(p->type) */
+}
+
+int sql_column_set_text(struct sql_column *p, const char *x, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(x);
+
+  long long v = 0;
+  switch(p->type) {
+    case sql_column_type_int:
+      if(!sql_column_parse_int(p, x, &v)) {
+        return 0;
+      } /* if(!sql_column_parse_int ... ) */
+      sql_column_store_int(p, v);
+      return 1;
+    case sql_column_type_float:
+      return sql_column_set_float(p, strtold(x, NULL));
+    case sql_column_type_none:
       /* Ungültiger typ! */
       sql_die_invalid_type(p);
+    default:
+      /* Nix weiter */
+      break;
   }; /* switch(p->type) */
 
-  p->type = sql_column_type_str;
-  p->str_value = sql_xstrdup(x);
+  if(p->value.str_capacity <= n) {
+    /* Der Puffer wird wiederverwendet und wächst nur */
+    p->value.str_capacity = 2 * n + 16;
+    p->value.str_value = (char*)sql_xrealloc(p->value.str_value, p->value.str_capacity);
+  } /* if ... */
+
+  memcpy(p->value.str_value, x, n);
+  p->value.str_value[n] = 0;
+  p->value.str_size = n;
+  p->value.is_null = 0;
+  return 1;
+}
+
+int sql_column_set_binary(struct sql_column *p, const char *x, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(x);
+
+  if(sql_column_type_int == p->type) {
+    /* Big-Endian, wie bei 0x-Literalen */
+    unsigned long long v = 0;
+    size_t i = 0;
+    for(; i < n; i += 1) {
+      if((0 != (v >> 56)) || (!p->is_unsigned && (0 != (v >> 55)) && (i + 1 == n))) {
+        /* Der Wert würde verfälscht */
+        return 0;
+      } /* if ... */
+      v = (v << 8) | (unsigned char)x[i];
+    } /* for ... */
+    sql_column_store_int(p, (long long)v);
+    return 1;
+  } else {
+    return sql_column_set_text(p, x, n);
+  } /* if(sql_column_type_int == p->type) */
+}
+
+int sql_column_set_string(struct sql_column *p, const char *x)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(x);
+  return sql_column_set_text(p, x, strlen(x));
 }
 
 void sql_column_add_sibbling(struct sql_column *p, struct sql_column *q, int pos)
@@ -22,6 +22,12 @@
  */
 
 #include "sql.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
 
 struct sql_context sql_context_init(void)
 {
@@ -31,13 +37,42 @@ struct sql_context sql_context_init(void)
   new_ctx.add_header = 0;
   new_ctx.add_types = 0;
   new_ctx.auto_close = 1;
+  new_ctx.build_index = 0;
+  new_ctx.use_index = 0;
+  new_ctx.skip_errors = 0;
+  new_ctx.column_stats = 0;
   new_ctx.current_table = NULL;
   new_ctx.first_table = NULL;
   new_ctx.last_table = NULL;
   new_ctx.current_column = NULL;
   new_ctx.source_file = NULL;
   new_ctx.float_fmt = "%.4f";
+  new_ctx.null_token = "";
   new_ctx.out_dir = NULL;
+  new_ctx.tables = NULL;
+  new_ctx.num_tables = 0;
+  new_ctx.offset = 0;
+  new_ctx.input_left = SIZE_MAX;
+  new_ctx.after_semicolon = 0;
+  new_ctx.buffer = NULL;
+  new_ctx.buffer_size = 0;
+  new_ctx.insert_table = NULL;
+  new_ctx.in_insert = 0;
+  new_ctx.skip_depth = 0;
+  new_ctx.skip_rows = 0;
+  new_ctx.skipped_statements = 0;
+  new_ctx.skipped_rows = 0;
+  new_ctx.sample_rate = 1.0;
+  new_ctx.sample_rows = 0;
+  new_ctx.seed = 0x9e3779b97f4a7c15ULL;
+  new_ctx.in_values = 0;
+  new_ctx.row_depth = 0;
+  new_ctx.flush_rows = 0;
+  new_ctx.flush_bytes = 0;
+  new_ctx.flush_ms = 0;
+  new_ctx.outputs = NULL;
+  new_ctx.num_outputs = 0;
+  new_ctx.state_file = NULL;
   return new_ctx;
 }
 
@@ -53,6 +88,12 @@ void sql_context_destroy(struct sql_context *p)
     sql_table_free(it);
     it = it_next;
   } /* for ... */
+  p->first_table = NULL;
+  p->last_table = NULL;
+
+  sql_xfree(p->buffer);
+  p->buffer = NULL;
+  p->buffer_size = 0;
 }
 
 void sql_context_add_table(struct sql_context *p, struct sql_table *q)
@@ -69,6 +110,14 @@ void sql_context_add_table(struct sql_context *p, struct sql_table *q)
   } /* for ... */
 
   sql_debug("Adding table `%s' to context...", q->name);
+  q->drop_data = !sql_context_is_selected(p, q->name);
+  if(p->column_stats && !q->drop_data) {
+    /* Statistik wird beim Setzen der Werte gesammelt */
+    struct sql_column *col = q->first_column;
+    for(; NULL != col; col = col->next) {
+      col->stats = sql_stats_new(col->type, col->is_unsigned);
+    } /* for ... */
+  } /* if(p->column_stats ... ) */
   if(NULL == p->first_table) {
     /* Tabelle am Anfang einfügen */
     p->first_table = q;
@@ -82,6 +131,21 @@ void sql_context_add_table(struct sql_context *p, struct sql_table *q)
   p->last_table = q;
 }
 
+struct sql_table *sql_context_get_table(struct sql_context *p, const char *name)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(name);
+
+  struct sql_table *it = p->first_table;
+  for(; NULL != it; it = it->next) {
+    if(0 == strcmp(it->name, name)) {
+      return it;
+    } /* if(0 == strcmp ... ) */
+  } /* for ... */
+
+  return NULL;
+}
+
 void sql_context_lock_table(struct sql_context *p, const char *name)
 {
   sql_check_nullptr(p);
@@ -109,6 +173,21 @@ void sql_context_unlock_table(struct sql_context *p)
 {
   sql_check_nullptr(p);
 
+  if(NULL != p->current_table) {
+    /* Die Stapel der Pipeline werden erst beim nächsten Sperren wieder
+     * gebraucht. So wächst der Speicher nicht mit der Anzahl der Tabellen.
+     */
+    sql_pipeline_close(p->current_table);
+
+    if((NULL != p->current_table->out) && (p->flush_rows || p->flush_bytes || p->flush_ms)) {
+      /* Beim Streaming kommen nach dem Entsperren keine Zeilen mehr nach */
+      sql_table_flush(p->current_table);
+    } /* if ... */
+
+    /* Den Schreibpuffer braucht die Tabelle erst wieder beim Sperren */
+    sql_table_release(p->current_table);
+  } /* if(NULL != p->current_table) */
+
   p->current_table = NULL;
   p->current_column = NULL;
 }
@@ -118,18 +197,107 @@ void sql_context_write_current_row(struct sql_context *p)
   sql_check_nullptr(p);
   sql_check_nullptr(p->current_table);
 
+  if(p->current_table->drop_data) {
+    /* Die Tabelle wurde nicht ausgewählt */
+    p->current_column = p->current_table->first_column;
+    p->current_table->rows += 1;
+    return;
+  } /* if(p->current_table->drop_data) */
+
   if(NULL == p->current_table->out) {
     /* Tabelle muss noch geöffnet werden! */
     sql_table_open(p->current_table, p);
   } /* if(NULL == p->current_table->out) */
 
-  /* Zeile schreiben */
-  sql_table_write_row(p->current_table);
+  /* Zeile schreiben oder an die Pipeline übergeben */
+  if(0 < p->sample_rows) {
+    sql_table_write_sample(p->current_table);
+  } else {
+    /* Die Statistik zählt nur Zeilen, die auch geschrieben werden */
+    sql_table_add_stats(p->current_table);
+    if(sql_pipeline_enabled()) {
+      sql_pipeline_write_row(p->current_table);
+    } else {
+      sql_table_write_row(p->current_table);
+    } /* if(sql_pipeline_enabled()) */
+  } /* if(0 < p->sample_rows) */
+
+  if((0 < p->flush_rows) && (0 == p->sample_rows) && (p->flush_rows <= ++p->current_table->unflushed_rows)) {
+    /* Alle N Zeilen leeren */
+    p->current_table->unflushed_rows = 0;
+    if(sql_pipeline_enabled()) {
+      sql_pipeline_flush(p->current_table);
+    } else {
+      sql_table_flush(p->current_table);
+    } /* if(sql_pipeline_enabled()) */
+  } /* if ... */
 
   p->current_column = p->current_table->first_column;
   p->current_table->rows += 1;
 }
 
+/* Zufallszahl für die Stichprobe (xorshift64*, reproduzierbar über den Startwert) */
+static unsigned long long sql_context_random(struct sql_context *p)
+{
+  p->seed ^= p->seed >> 12;
+  p->seed ^= p->seed << 25;
+  p->seed ^= p->seed >> 27;
+  return p->seed * 0x2545f4914f6cdd1dULL;
+}
+
+int sql_context_sample_row(struct sql_context *p)
+{
+  sql_check_nullptr(p);
+
+  struct sql_table *tab = p->insert_table;
+  if(NULL == tab) {
+    /* Fehler werden beim Parsen gemeldet */
+    return 1;
+  } /* if(NULL == tab) */
+
+  if(tab->drop_data) {
+    /* Zeilen nicht gewählter Tabellen müssen nicht gelesen werden */
+    return 0;
+  } /* if(tab->drop_data) */
+
+  if((1.0 > p->sample_rate) && ((double)(sql_context_random(p) >> 11) * 0x1.0p-53 >= p->sample_rate)) {
+    /* Nicht in der Stichprobe (Bernoulli) */
+    return 0;
+  } /* if ... */
+
+  if(0 < p->sample_rows) {
+    if(NULL == tab->samples) {
+      tab->samples = (struct sql_sample*)sql_xmalloc(p->sample_rows * sizeof(struct sql_sample));
+      memset(tab->samples, 0, p->sample_rows * sizeof(struct sql_sample));
+      tab->num_samples = p->sample_rows;
+    } /* if(NULL == tab->samples) */
+
+    /* Reservoir: Die i-te Zeile ersetzt mit Wahrscheinlichkeit n/i einen Platz */
+    const size_t i = tab->sample_seen;
+    tab->sample_seen += 1;
+    if(i < p->sample_rows) {
+      tab->sample_slot = i;
+    } else {
+      const size_t j = sql_context_random(p) % (i + 1);
+      if(j >= p->sample_rows) {
+        return 0;
+      } /* if(j >= p->sample_rows) */
+      tab->sample_slot = j;
+    } /* if(i < p->sample_rows) */
+  } /* if(0 < p->sample_rows) */
+
+  return 1;
+}
+
+void sql_context_skip_row(struct sql_context *p)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(p->current_table);
+
+  /* Die Zeile wurde vom Scanner übersprungen, zählt aber mit */
+  p->current_table->rows += 1;
+}
+
 struct sql_column *sql_context_get_current_column(struct sql_context *p)
 {
   sql_check_nullptr(p);
@@ -144,3 +312,178 @@ void sql_context_next_column(struct sql_context *p)
     p->current_column = p->current_column->next;
   } /* if(NULL != p->current_column) */
 }
+
+void sql_context_select_table(struct sql_context *p, char *name)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(name);
+
+  p->tables = (char**)sql_xrealloc(p->tables, (1 + p->num_tables) * sizeof(char*));
+  p->tables[p->num_tables] = name;
+  p->num_tables += 1;
+}
+
+int sql_context_is_selected(const struct sql_context *p, const char *name)
+{
+  sql_check_nullptr(p);
+
+  if(0 == p->num_tables) {
+    /* Ohne Auswahl werden alle Tabellen verarbeitet */
+    return 1;
+  } /* if(0 == p->num_tables) */
+
+  size_t i = 0;
+  for(; i < p->num_tables; i += 1) {
+    if(0 == strcmp(p->tables[i], name)) {
+      return 1;
+    } /* if(0 == strcmp ... ) */
+  } /* for ... */
+
+  return 0;
+}
+
+void sql_context_add_output(struct sql_context *p, char *spec)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(spec);
+
+  char *sep = strrchr(spec, '=');
+  char *end = NULL;
+  errno = 0;
+  const long fd = (NULL != sep) ? strtol(sep + 1, &end, 10) : -1;
+  if((NULL == sep) || (spec == sep) || (end == sep + 1) || ('\0' != *end) || (0 != errno) || (0 > fd) || (INT_MAX < fd)) {
+    /* Programmabbruch, da die Angabe unvollständig ist! */
+    sql_die("Invalid output `%s'! Expected TABLE=FD.", spec);
+  } /* if ... */
+
+  if(0 > fcntl((int)fd, F_GETFD)) {
+    /* Programmabbruch, da der Deskriptor nicht geöffnet ist! */
+    sql_die("Invalid output `%s'! Descriptor %li is not open.", spec, fd);
+  } /* if(0 > fcntl ... ) */
+
+  p->outputs = (struct sql_output*)sql_xrealloc(p->outputs, (1 + p->num_outputs) * sizeof(struct sql_output));
+  struct sql_output *o = p->outputs + p->num_outputs;
+  o->spec = spec;
+  o->name_size = (size_t)(sep - spec);
+  o->fd = (int)fd;
+  o->has_header = 0;
+  p->num_outputs += 1;
+}
+
+struct sql_output *sql_context_get_output(const struct sql_context *p, const char *name)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(name);
+
+  size_t i = 0;
+  for(; i < p->num_outputs; i += 1) {
+    const struct sql_output *o = p->outputs + i;
+    if((strlen(name) == o->name_size) && (0 == strncmp(o->spec, name, o->name_size))) {
+      return p->outputs + i;
+    } /* if ... */
+  } /* for ... */
+
+  return NULL;
+}
+
+void sql_context_skip_statement(struct sql_context *p)
+{
+  sql_check_nullptr(p);
+
+  struct sql_table *tab = p->current_table;
+  if(p->in_insert) {
+    /* Die Zeilen gehören zur Zieltabelle der Einfügeanweisung */
+    tab = p->insert_table;
+  } else {
+    /* Nur Einfügeanweisungen enthalten Zeilen */
+    p->skip_rows = 0;
+  } /* if(p->in_insert) */
+
+  if(NULL != tab) {
+    tab->skipped_statements += 1;
+    tab->skipped_rows += p->skip_rows;
+    /* Die angefangene Zeile wird verworfen */
+    if(tab == p->current_table) {
+      p->current_column = tab->first_column;
+    } /* if(tab == p->current_table) */
+  } else {
+    p->skipped_statements += 1;
+    p->skipped_rows += p->skip_rows;
+  } /* if(NULL != tab) */
+
+  p->insert_table = NULL;
+  p->in_insert = 0;
+  p->skip_depth = 0;
+  p->skip_rows = 0;
+}
+
+void sql_context_report_skipped(const struct sql_context *p)
+{
+  sql_check_nullptr(p);
+
+  const struct sql_table *it = p->first_table;
+  for(; NULL != it; it = it->next) {
+    if(0 < it->skipped_statements) {
+      sql_warning("Skipped %zu statements with %zu rows of table `%s'!", it->skipped_statements, it->skipped_rows, it->name);
+    } /* if(0 < it->skipped_statements) */
+  } /* for ... */
+
+  if(0 < p->skipped_statements) {
+    sql_warning("Skipped %zu statements with %zu rows outside of known tables!", p->skipped_statements, p->skipped_rows);
+  } /* if(0 < p->skipped_statements) */
+}
+
+char *sql_context_get_buffer(struct sql_context *p, size_t n)
+{
+  sql_check_nullptr(p);
+
+  if(p->buffer_size < n) {
+    /* Der Puffer wächst nur */
+    p->buffer_size = 2 * n;
+    p->buffer = (char*)sql_xrealloc(p->buffer, p->buffer_size);
+  } /* if(p->buffer_size < n) */
+
+  return p->buffer;
+}
+
+size_t sql_context_read_input(struct sql_context *p, FILE *in, char *buf, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(in);
+
+  if(n > p->input_left) {
+    /* Nicht über das Ende des Bereichs hinaus lesen */
+    n = p->input_left;
+  } /* if(n > p->input_left) */
+
+  /* Bereiche (Index, inkrementell) werden mit fseeko() angesprungen. Die
+   * Position gilt dann nur für den stdio-Puffer, nicht für den Deskriptor.
+   */
+  if((p->flush_rows || p->flush_bytes || p->flush_ms) && !p->use_index && (NULL == p->state_file)) {
+    struct pollfd pfd = {fileno(in), POLLIN, 0};
+    if((NULL != p->current_table) && sql_pipeline_enabled() && (0 == poll(&pfd, 1, 0))) {
+      /* Nur wenn gleich gewartet wird, alle Zeilen an die Pipeline geben */
+      sql_pipeline_flush(p->current_table);
+    } /* if ... */
+
+    /* Streaming: Nicht warten, bis der ganze Puffer gefüllt ist */
+    ssize_t l = 0;
+    while((0 < n) && (0 > (l = read(fileno(in), buf, n))) && (EINTR == errno));
+    if(0 > l) {
+      /* Programmabbruch, da die Eingabe nicht gelesen werden konnte! */
+      sql_die("Could not read from `%s'! (Error: %m)", p->source_file);
+    } /* if(0 > l) */
+
+    p->input_left -= (size_t)l;
+    return (size_t)l;
+  } /* if ... streaming ... */
+
+  const size_t l = (0 < n) ? fread(buf, 1, n, in) : 0;
+  if(ferror(in)) {
+    /* Programmabbruch, da die Eingabe nicht gelesen werden konnte! */
+    sql_die("Could not read from `%s'! (Error: %m)", p->source_file);
+  } /* if(ferror(in)) */
+
+  p->input_left -= l;
+  return l;
+}
@@ -0,0 +1,152 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Zeitgesteuertes Leeren der Ausgabe:
+ * Geöffnete Tabellen melden sich beim Flusher an. Ein eigener Thread leert
+ * sie alle N Millisekunden, so dass beim Schreiben der Zeilen nichts geprüft
+ * werden muss. Zeilen, die noch in der Pipeline liegen, werden beim nächsten
+ * Schreiben ihrer Tabelle weitergereicht.
+ */
+
+static struct {
+  pthread_mutex_t    lock;
+  pthread_cond_t     wakeup;
+  pthread_t          thread;
+  int                running;
+  int                shutdown;
+  size_t             interval;
+  struct sql_table **tables;
+  size_t             num_tables;
+} sql_flusher = {
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  0, 0, 0, 0, NULL, 0
+};
+
+static void *sql_flusher_thread(void *arg)
+{
+  (void)arg;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  pthread_mutex_lock(&sql_flusher.lock);
+  while(!sql_flusher.shutdown) {
+    ts.tv_sec += sql_flusher.interval / 1000;
+    ts.tv_nsec += (sql_flusher.interval % 1000) * 1000000L;
+    if(1000000000L <= ts.tv_nsec) {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000L;
+    } /* if ... */
+
+    while(!sql_flusher.shutdown && (ETIMEDOUT != pthread_cond_timedwait(&sql_flusher.wakeup, &sql_flusher.lock, &ts)));
+    if(sql_flusher.shutdown) {
+      /* Beim Beenden werden die Tabellen geschlossen */
+      break;
+    } /* if(sql_flusher.shutdown) */
+
+    size_t i = 0;
+    for(; i < sql_flusher.num_tables; i += 1) {
+      sql_table_flush(sql_flusher.tables[i]);
+    } /* for ... */
+    sql_pipeline_request_flush();
+  } /* while(!sql_flusher.shutdown) */
+  pthread_mutex_unlock(&sql_flusher.lock);
+  return NULL;
+}
+
+void sql_flusher_init(size_t interval)
+{
+  sql_assert(0 < interval);
+  sql_assert(!sql_flusher.running);
+
+  sql_flusher.interval = interval;
+  sql_flusher.shutdown = 0;
+  if(0 != pthread_create(&sql_flusher.thread, NULL, sql_flusher_thread, NULL)) {
+    /* Programmabbruch, da der Thread nicht gestartet werden konnte! */
+    sql_die("Could not start flush thread!");
+  } /* if(0 != pthread_create ... ) */
+  sql_flusher.running = 1;
+  sql_debug("Flushing output every %zu ms.", interval);
+}
+
+void sql_flusher_shutdown(void)
+{
+  if(!sql_flusher.running) {
+    /* Der Flusher wurde nicht gestartet */
+    return;
+  } /* if(!sql_flusher.running) */
+
+  pthread_mutex_lock(&sql_flusher.lock);
+  sql_flusher.shutdown = 1;
+  pthread_cond_signal(&sql_flusher.wakeup);
+  pthread_mutex_unlock(&sql_flusher.lock);
+
+  pthread_join(sql_flusher.thread, NULL);
+  sql_flusher.running = 0;
+  sql_xfree(sql_flusher.tables);
+  sql_flusher.tables = NULL;
+  sql_flusher.num_tables = 0;
+}
+
+void sql_flusher_add(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  if(!sql_flusher.running) {
+    /* Ohne Intervall wird nur nach Zeilen oder Bytes geleert */
+    return;
+  } /* if(!sql_flusher.running) */
+
+  pthread_mutex_lock(&sql_flusher.lock);
+  sql_flusher.tables = (struct sql_table**)sql_xrealloc(sql_flusher.tables, (1 + sql_flusher.num_tables) * sizeof(struct sql_table*));
+  sql_flusher.tables[sql_flusher.num_tables] = p;
+  sql_flusher.num_tables += 1;
+  pthread_mutex_unlock(&sql_flusher.lock);
+}
+
+void sql_flusher_remove(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  if(!sql_flusher.running) {
+    /* Nix weiter */
+    return;
+  } /* if(!sql_flusher.running) */
+
+  pthread_mutex_lock(&sql_flusher.lock);
+  size_t i = 0;
+  for(; i < sql_flusher.num_tables; i += 1) {
+    if(p == sql_flusher.tables[i]) {
+      /* Letzten Eintrag nach vorne holen */
+      sql_flusher.num_tables -= 1;
+      sql_flusher.tables[i] = sql_flusher.tables[sql_flusher.num_tables];
+      break;
+    } /* if(p == ... ) */
+  } /* for ... */
+  pthread_mutex_unlock(&sql_flusher.lock);
+}
@@ -0,0 +1,485 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/* Inkrementelle Umwandlung:
+ * Ein Vorabscan sucht zeilenweise (memchr) nach den Anweisungen, die
+ * mysqldump an den Zeilenanfang schreibt:
+ *   CREATE TABLE `NAME` ... ;    (Schema bis zur Zeile, die mit ';' endet)
+ *   LOCK TABLES `NAME` ...       (Daten bis einschließlich UNLOCK TABLES;)
+ * Der Rohtext jeder Tabelle wird dabei gehasht. Nur Tabellen, deren Hash sich
+ * gegenüber dem letzten Lauf geändert hat oder deren Ausgabedatei fehlt,
+ * werden wie beim Index über ihre Byte-Bereiche geparst.
+ *
+ * Aufbau der Zustandsdatei (eine Zeile je Eintrag):
+ *   file NAME
+ *   table HASH NAME
+ * Die Tabellen gehören zur vorangehenden Eingabedatei.
+ */
+
+#define SQL_INCREMENTAL_BLOCK  (1 << 20)
+#define SQL_INCREMENTAL_PEEK   256
+
+/* Hash über einen Datenstrom, 8 Bytes je Schritt */
+struct sql_hash {
+  uint64_t h;
+  uint64_t length;
+  unsigned char tail[8];
+  size_t   tail_size;
+}; /* struct sql_hash */
+
+static inline uint64_t sql_hash_step(uint64_t h, uint64_t w)
+{
+  h ^= w * 0x9e3779b97f4a7c15ULL;
+  h = (h << 31) | (h >> 33);
+  return h * 0x94d049bb133111ebULL;
+}
+
+static uint64_t sql_hash_mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static void sql_hash_init(struct sql_hash *p, uint64_t seed)
+{
+  p->h = seed;
+  p->length = 0;
+  p->tail_size = 0;
+}
+
+static void sql_hash_update(struct sql_hash *p, const char *x, size_t n)
+{
+  uint64_t w = 0;
+  p->length += n;
+
+  if(0 < p->tail_size) {
+    /* Angefangenes Wort vervollständigen */
+    const size_t k = (n < 8 - p->tail_size) ? n : 8 - p->tail_size;
+    memcpy(p->tail + p->tail_size, x, k);
+    p->tail_size += k;
+    x += k;
+    n -= k;
+    if(8 > p->tail_size) {
+      return;
+    } /* if(8 > p->tail_size) */
+    memcpy(&w, p->tail, 8);
+    p->h = sql_hash_step(p->h, w);
+    p->tail_size = 0;
+  } /* if(0 < p->tail_size) */
+
+  uint64_t h = p->h;
+  for(; 8 <= n; x += 8, n -= 8) {
+    memcpy(&w, x, 8);
+    h = sql_hash_step(h, w);
+  } /* for ... */
+  p->h = h;
+
+  memcpy(p->tail, x, n);
+  p->tail_size = n;
+}
+
+static uint64_t sql_hash_final(const struct sql_hash *p)
+{
+  uint64_t w = 0;
+  memcpy(&w, p->tail, p->tail_size);
+  return sql_hash_mix(sql_hash_step(p->h, w) ^ p->length);
+}
+
+/* Einstellungen, die die Ausgabe verändern, gehen in jeden Hash ein */
+static uint64_t sql_incremental_get_seed(const struct sql_context *p)
+{
+  char buf[PATH_MAX] = {0};
+  const int n = snprintf(buf, sizeof(buf), "c%i n%i t%i s%i C%i f%s N%s r%g R%zu S%llu",
+                         (int)p->compress, (int)p->add_header, (int)p->add_types,
+                         (int)p->skip_errors, (int)p->column_stats,
+                         p->float_fmt, (NULL != p->null_token) ? p->null_token : "",
+                         p->sample_rate, p->sample_rows, p->seed);
+
+  struct sql_hash h;
+  sql_hash_init(&h, 0);
+  sql_hash_update(&h, buf, ((0 < n) && ((size_t)n < sizeof(buf))) ? (size_t)n : strlen(buf));
+  return sql_hash_final(&h);
+}
+
+/* Liefert den Tabellennamen nach PREFIX, falls die Zeile damit beginnt */
+static int sql_incremental_match(const char *line, size_t n, const char *prefix, char *name, size_t name_size)
+{
+  const size_t k = strlen(prefix);
+  if((n <= k) || (0 != memcmp(line, prefix, k))) {
+    return 0;
+  } /* if ... */
+
+  const char *end = (const char*)memchr(line + k, '`', n - k);
+  if((NULL == end) || (name_size <= (size_t)(end - line - k))) {
+    /* Name zu lang oder nicht abgeschlossen */
+    return 0;
+  } /* if ... */
+
+  memcpy(name, line + k, end - line - k);
+  name[end - line - k] = 0;
+  return 1;
+}
+
+static void sql_incremental_add_range(struct sql_table *p, size_t begin)
+{
+  p->ranges = (struct sql_range*)sql_xrealloc(p->ranges, (1 + p->num_ranges) * sizeof(struct sql_range));
+  p->ranges[p->num_ranges].begin = begin;
+  p->ranges[p->num_ranges].end = begin;
+  p->ranges[p->num_ranges].rows = 0;
+  p->num_ranges += 1;
+}
+
+/* Vorabscan: Liefert die Tabellen mit Bereichen und Hashes. Ist der Aufbau
+ * unbekannt, wird *is_valid auf 0 gesetzt.
+ */
+static struct sql_table *sql_incremental_scan(const struct sql_context *p, FILE *in, int *is_valid, size_t *size)
+{
+  char *buf = (char*)sql_xmalloc(SQL_INCREMENTAL_BLOCK + SQL_INCREMENTAL_PEEK);
+  size_t have = 0;
+  size_t pos = 0;
+  size_t base = 0;
+  int    eof = 0;
+  int    at_line_start = 1;
+  char   last_char = 0;
+
+  struct sql_table *first = NULL;
+  struct sql_table *active = NULL;
+  int    in_schema = 0;
+  int    is_unlock = 0;
+  struct sql_hash h;
+  const uint64_t seed = sql_incremental_get_seed(p);
+
+  *is_valid = 1;
+  if(0 != fseeko(in, 0, SEEK_SET)) {
+    /* Programmabbruch, da die Eingabe nicht gelesen werden kann! */
+    sql_die("Could not seek in `%s'! (Error: %m)", p->source_file);
+  } /* if(0 != fseeko ... ) */
+
+  for(;;) {
+    if(!eof && ((pos == have) || (at_line_start && (have - pos < SQL_INCREMENTAL_PEEK)))) {
+      /* Rest nach vorne holen und nachladen */
+      memmove(buf, buf + pos, have - pos);
+      base += pos;
+      have -= pos;
+      pos = 0;
+
+      const size_t n = fread(buf + have, 1, SQL_INCREMENTAL_BLOCK + SQL_INCREMENTAL_PEEK - have, in);
+      if(0 == n) {
+        if(ferror(in)) {
+          /* Programmabbruch, da die Eingabe nicht gelesen werden kann! */
+          sql_die("Could not read `%s'! (Error: %m)", p->source_file);
+        } /* if(ferror(in)) */
+        eof = 1;
+      } /* if(0 == n) */
+      have += n;
+    } /* if ... */
+
+    if(pos == have) {
+      /* Ende der Eingabe */
+      break;
+    } /* if(pos == have) */
+
+    if(at_line_start) {
+      char name[SQL_INCREMENTAL_PEEK] = {0};
+      const char *line = buf + pos;
+      const size_t n = have - pos;
+
+      if(NULL == active) {
+        if(sql_incremental_match(line, n, "CREATE TABLE `", name, sizeof(name))
+            || sql_incremental_match(line, n, "CREATE TABLE IF NOT EXISTS `", name, sizeof(name))) {
+          active = sql_index_get_table(&first, name);
+          active->schema.begin = base + pos;
+          in_schema = 1;
+          sql_hash_init(&h, seed);
+        } else if(sql_incremental_match(line, n, "LOCK TABLES `", name, sizeof(name))) {
+          active = sql_index_get_table(&first, name);
+          sql_incremental_add_range(active, base + pos);
+          in_schema = 0;
+          is_unlock = 0;
+          sql_hash_init(&h, seed);
+        } else if((n > 7) && (0 == memcmp(line, "INSERT ", 7))) {
+          /* Daten außerhalb von LOCK/UNLOCK: Bereiche nicht bestimmbar */
+          *is_valid = 0;
+          break;
+        } /* if ... */
+      } else if(!in_schema && (n > 14) && (0 == memcmp(line, "UNLOCK TABLES;", 14))) {
+        is_unlock = 1;
+      } /* if(NULL == active) */
+    } /* if(at_line_start) */
+
+    const char *nl = (const char*)memchr(buf + pos, '\n', have - pos);
+    const size_t end = (NULL != nl) ? (size_t)(nl - buf) + 1 : have;
+
+    if(NULL != active) {
+      sql_hash_update(&h, buf + pos, end - pos);
+    } /* if(NULL != active) */
+
+    if(NULL != nl) {
+      const char c = (nl > buf + pos) ? nl[-1] : last_char;
+      if((NULL != active) && ((in_schema && (';' == c)) || (!in_schema && is_unlock))) {
+        /* Abschnitt vollständig: Hash in den der Tabelle einrechnen */
+        if(in_schema) {
+          active->schema.end = base + end;
+        } else {
+          active->ranges[active->num_ranges - 1].end = base + end;
+        } /* if(in_schema) */
+        active->hash = sql_hash_mix(active->hash * 0x9e3779b97f4a7c15ULL + sql_hash_final(&h));
+        active = NULL;
+      } /* if ... */
+      last_char = '\n';
+      at_line_start = 1;
+    } else {
+      last_char = buf[end - 1];
+      at_line_start = 0;
+    } /* if(NULL != nl) */
+    pos = end;
+  } /* for(;;) */
+
+  if((NULL != active) && *is_valid) {
+    /* Abschnitt am Dateiende nicht abgeschlossen */
+    sql_warning("Incomplete statement for table `%s' at end of `%s'!", active->name, p->source_file);
+    *is_valid = 0;
+  } /* if ... */
+
+  *size = base + have;
+  sql_xfree(buf);
+  return first;
+}
+
+/* Liest die Hashes der Tabellen von SOURCE aus der Zustandsdatei */
+static struct sql_table *sql_incremental_read_state(const char *filename, const char *source)
+{
+  FILE *in = NULL;
+  if(NULL == (in = fopen(filename, "r"))) {
+    if(ENOENT != errno) {
+      /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+      sql_die("Could not open state file `%s'! (Error: %m)", filename);
+    } /* if(ENOENT != errno) */
+    return NULL;
+  } /* if(NULL == ... fopen ... ) */
+
+  struct sql_table *first = NULL;
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t l = 0;
+  size_t lineno = 0;
+  int is_source = 0;
+
+  while(-1 != (l = getline(&line, &line_size, in))) {
+    unsigned long long hash = 0;
+    int name_pos = 0;
+    lineno += 1;
+
+    if((0 < l) && ('\n' == line[l - 1])) {
+      /* Zeilenumbruch gehört nicht zum Namen */
+      line[l - 1] = 0;
+    } /* if ... '\n' ... */
+
+    if(('#' == *line) || (0 == *line)) {
+      /* Kommentare und Leerzeilen überspringen */
+      continue;
+    } else if(0 == strncmp(line, "file ", 5)) {
+      is_source = (0 == strcmp(line + 5, source));
+    } else if(1 == sscanf(line, "table %llx %n", &hash, &name_pos) && (0 < name_pos)) {
+      if(is_source) {
+        sql_index_get_table(&first, line + name_pos)->hash = hash;
+      } /* if(is_source) */
+    } else {
+      /* Programmabbruch, da der Zustand beschädigt ist! */
+      sql_die("Invalid entry in state file `%s' in line %zu!", filename, lineno);
+    } /* if ... */
+  } /* while ... */
+
+  sql_xfree(line);
+  fclose(in);
+  return first;
+}
+
+/* Ersetzt die Einträge von SOURCE in der Zustandsdatei */
+static void sql_incremental_write_state(const char *filename, const char *source, const struct sql_table *first)
+{
+  char tmp_filename[PATH_MAX] = {0};
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+  FILE *out = NULL;
+  if(NULL == (out = fopen(tmp_filename, "w"))) {
+    /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+    sql_die("Could not open state file `%s'! (Error: %m)", tmp_filename);
+  } /* if(NULL == ... fopen ... ) */
+  fprintf(out, "# sqldump2csv incremental state\n");
+
+  FILE *in = fopen(filename, "r");
+  if(NULL != in) {
+    /* Einträge der übrigen Eingabedateien übernehmen */
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t l = 0;
+    int is_source = 0;
+
+    while(-1 != (l = getline(&line, &line_size, in))) {
+      if('#' == *line) {
+        /* Kopfzeile wird neu geschrieben */
+        continue;
+      } else if(0 == strncmp(line, "file ", 5)) {
+        const size_t n = (size_t)l - 5 - (('\n' == line[l - 1]) ? 1 : 0);
+        is_source = (strlen(source) == n) && (0 == memcmp(line + 5, source, n));
+      } /* if ... */
+
+      if(!is_source) {
+        fwrite(line, 1, l, out);
+      } /* if(!is_source) */
+    } /* while ... */
+    sql_xfree(line);
+    fclose(in);
+  } /* if(NULL != in) */
+
+  fprintf(out, "file %s\n", source);
+  const struct sql_table *it = first;
+  for(; NULL != it; it = it->next) {
+    fprintf(out, "table %016llx %s\n", it->hash, it->name);
+  } /* for ... */
+
+  if(0 != fclose(out)) {
+    /* Programmabbruch, da der Zustand unvollständig ist! */
+    sql_die("Could not write state file `%s'! (Error: %m)", tmp_filename);
+  } /* if(0 != fclose(out)) */
+  if(0 != rename(tmp_filename, filename)) {
+    /* Programmabbruch, da der alte Zustand sonst bestehen bliebe! */
+    sql_die("Could not rename `%s' to `%s'! (Error: %m)", tmp_filename, filename);
+  } /* if(0 != rename ... ) */
+}
+
+/* Entfernt eine veraltete Ausgabe; fehlt sie, ist das kein Fehler */
+static void sql_incremental_remove(const char *filename)
+{
+  if((0 != unlink(filename)) && (ENOENT != errno)) {
+    /* Programmabbruch, da sonst veraltete Zeilen stehen blieben! */
+    sql_die("Could not remove `%s'! (Error: %m)", filename);
+  } /* if ... unlink ... */
+}
+
+/* Entfernt die Ausgaben einer Tabelle; auf Deskriptoren gibt es nur die
+ * Statistik als Datei.
+ */
+static void sql_incremental_remove_outputs(const struct sql_context *p, const struct sql_table *t)
+{
+  char filename[2 * PATH_MAX + 16] = {0};
+  if(NULL == sql_context_get_output(p, t->name)) {
+    sql_table_get_filename(t, p, filename, sizeof(filename));
+    sql_incremental_remove(filename);
+  } /* if(NULL == sql_context_get_output ... ) */
+  sql_table_get_stats_filename(t, p, filename, sizeof(filename));
+  sql_incremental_remove(filename);
+}
+
+static void sql_incremental_free(struct sql_table *first)
+{
+  while(NULL != first) {
+    struct sql_table *it_next = first->next;
+    sql_table_free(first);
+    first = it_next;
+  } /* while ... */
+}
+
+void sql_incremental_run(struct sql_context *p, FILE *in)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(in);
+  sql_check_nullptr(p->state_file);
+
+  int is_valid = 0;
+  size_t size = 0;
+  struct sql_table *first = sql_incremental_scan(p, in, &is_valid, &size);
+
+  if(!is_valid) {
+    /* Unbekannter Aufbau: Ganze Datei parsen, Zustand verwerfen */
+    sql_warning("Could not split `%s' into tables! Converting all tables...", p->source_file);
+    const struct sql_range r = {0, size, 0};
+    sql_parse_range(p, in, &r);
+    sql_incremental_free(first);
+    sql_incremental_write_state(p->state_file, p->source_file, NULL);
+    return;
+  } /* if(!is_valid) */
+
+  struct sql_table *previous = sql_incremental_read_state(p->state_file, p->source_file);
+  struct sql_table *it = first;
+  for(; NULL != it; it = it->next) {
+    const struct sql_table *old = previous;
+    for(; (NULL != old) && (0 != strcmp(old->name, it->name)); old = old->next);
+
+    if(!sql_context_is_selected(p, it->name)) {
+      /* Ausgabe bleibt unverändert, also auch der gespeicherte Hash */
+      it->hash = (NULL != old) ? old->hash : 0;
+      continue;
+    } /* if(!sql_context_is_selected ... ) */
+
+    /* Auf einen Deskriptor wird nur geschrieben, was sich geändert hat */
+    char filename[2 * PATH_MAX] = {0};
+    char stats_filename[2 * PATH_MAX + 16] = {0};
+    sql_table_get_filename(it, p, filename, sizeof(filename));
+    sql_table_get_stats_filename(it, p, stats_filename, sizeof(stats_filename));
+    if((NULL != old) && (old->hash == it->hash)
+        && ((NULL != sql_context_get_output(p, it->name)) || (0 == access(filename, F_OK)))
+        && (!p->column_stats || (0 == access(stats_filename, F_OK)))) {
+      /* Ausgabe ist aktuell */
+      sql_debug("Table `%s' is unchanged.", it->name);
+      continue;
+    } /* if ... */
+
+    sql_debug("Converting changed table `%s'...", it->name);
+    if(it->schema.begin == it->schema.end) {
+      /* Programmabbruch, da die Tabelle nicht angelegt werden kann! */
+      sql_die("Input file `%s' has no schema for table `%s'!", p->source_file, it->name);
+    } /* if ... */
+
+    /* Ohne Zeilen wird die Ausgabe nicht geöffnet, alte Zeilen blieben stehen */
+    sql_incremental_remove_outputs(p, it);
+    sql_index_parse_table(p, in, it, p->source_file);
+  } /* for ... */
+
+  const struct sql_table *old = previous;
+  for(; NULL != old; old = old->next) {
+    const struct sql_table *cur = first;
+    for(; (NULL != cur) && (0 != strcmp(old->name, cur->name)); cur = cur->next);
+
+    if(NULL == cur) {
+      /* Die Tabelle gibt es nicht mehr, ihre Ausgabe wäre veraltet */
+      sql_debug("Removing outputs of dropped table `%s'...", old->name);
+      sql_incremental_remove_outputs(p, old);
+    } /* if(NULL == cur) */
+  } /* for ... */
+
+  sql_incremental_write_state(p->state_file, p->source_file, first);
+  sql_incremental_free(previous);
+  sql_incremental_free(first);
+}
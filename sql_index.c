@@ -0,0 +1,226 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <limits.h>
+#include <sys/stat.h>
+
+/* Aufbau der Indexdatei (eine Zeile je Eintrag):
+ *   input SIZE SECONDS NANOSECONDS
+ *   schema BEGIN END NAME
+ *   data BEGIN END ROWS NAME
+ * Die Bereiche sind Byte-Offsets [BEGIN, END) in der Eingabe. Größe und
+ * Änderungszeit binden den Index an die Eingabe, aus der er entstand.
+ */
+
+/* Liefert 0, wenn INPUT keine reguläre Datei ist. */
+static int sql_index_stat(FILE *input, struct stat *st)
+{
+  return (0 == fstat(fileno(input), st)) && S_ISREG(st->st_mode);
+}
+
+void sql_index_get_filename(const struct sql_context *p, char *buf, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(buf);
+
+  if(NULL == p->out_dir) {
+    snprintf(buf, n, "%s.idx", p->source_file);
+  } else {
+    snprintf(buf, n, "%s/%s.idx", p->out_dir, p->source_file);
+  } /* if(NULL == p->out_dir) */
+}
+
+void sql_index_write(const struct sql_context *p, FILE *input, const char *filename)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(input);
+  sql_check_nullptr(filename);
+
+  FILE *out = NULL;
+  if(NULL == (out = fopen(filename, "w"))) {
+    /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+    sql_die("Could not open index file `%s'! (Error: %m)", filename);
+  } /* if(NULL == ... fopen ... ) */
+
+  sql_debug("Writing index file `%s'...", filename);
+  fprintf(out, "# sqldump2csv index of `%s'\n", p->source_file);
+
+  struct stat st;
+  if(sql_index_stat(input, &st)) {
+    fprintf(out, "input %lld %lld %ld\n", (long long)st.st_size, (long long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+  } else {
+    /* Ohne Größe und Zeit wird der Index später abgelehnt */
+    sql_warning("Index file `%s' cannot be used, since the input is not a regular file!", filename);
+  } /* if(sql_index_stat ... ) */
+
+  const struct sql_table *it = p->first_table;
+  for(; NULL != it; it = it->next) {
+    fprintf(out, "schema %zu %zu %s\n", it->schema.begin, it->schema.end, it->name);
+
+    size_t i = 0;
+    for(; i < it->num_ranges; i += 1) {
+      const struct sql_range *r = it->ranges + i;
+      fprintf(out, "data %zu %zu %zu %s\n", r->begin, r->end, r->rows, it->name);
+    } /* for ... */
+  } /* for ... */
+
+  if(0 != fclose(out)) {
+    /* Programmabbruch, da der Index unvollständig ist! */
+    sql_die("Could not write index file `%s'! (Error: %m)", filename);
+  } /* if(0 != fclose(out)) */
+}
+
+struct sql_table *sql_index_get_table(struct sql_table **first, const char *name)
+{
+  struct sql_table *it = *first;
+  struct sql_table *last = NULL;
+  for(; NULL != it; last = it, it = it->next) {
+    if(0 == strcmp(it->name, name)) {
+      return it;
+    } /* if(0 == strcmp ... ) */
+  } /* for ... */
+
+  /* Neuen Eintrag am Ende anhängen */
+  struct sql_table *tab = sql_table_new();
+  sql_table_set_name(tab, name);
+  if(NULL == last) {
+    *first = tab;
+  } else {
+    last->next = tab;
+    tab->prev = last;
+  } /* if(NULL == last) */
+  return tab;
+}
+
+struct sql_table *sql_index_read(FILE *input, const char *filename)
+{
+  sql_check_nullptr(input);
+  sql_check_nullptr(filename);
+
+  struct stat st;
+  if(!sql_index_stat(input, &st)) {
+    /* Programmabbruch, da der Index nicht geprüft werden kann! */
+    sql_die("Index lookup requires a regular input file!");
+  } /* if(!sql_index_stat ... ) */
+
+  FILE *in = NULL;
+  if(NULL == (in = fopen(filename, "r"))) {
+    /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+    sql_die("Could not open index file `%s'! (Error: %m)", filename);
+  } /* if(NULL == ... fopen ... ) */
+
+  struct sql_table *first = NULL;
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t l = 0;
+  size_t lineno = 0;
+  int has_input = 0;
+
+  while(-1 != (l = getline(&line, &line_size, in))) {
+    struct sql_range r = {0, 0, 0};
+    int name_pos = 0;
+    lineno += 1;
+
+    if((0 < l) && ('\n' == line[l - 1])) {
+      /* Zeilenumbruch gehört nicht zum Namen */
+      line[l - 1] = 0;
+    } /* if ... '\n' ... */
+
+    if(('#' == *line) || (0 == *line)) {
+      /* Kommentare und Leerzeilen überspringen */
+      continue;
+    } else if(!has_input) {
+      long long size = 0;
+      long long sec = 0;
+      long nsec = 0;
+      if(3 != sscanf(line, "input %lld %lld %ld", &size, &sec, &nsec)) {
+        /* Programmabbruch, da der Index zu einer älteren Version gehört! */
+        sql_die("Index file `%s' does not describe its input, please rebuild it!", filename);
+      } else if((size != (long long)st.st_size) || (sec != (long long)st.st_mtim.tv_sec) || (nsec != st.st_mtim.tv_nsec)) {
+        /* Programmabbruch, da die Offsets nicht mehr stimmen! */
+        sql_die("Index file `%s' does not match the input (size or modification time changed), please rebuild it!", filename);
+      } /* if ... */
+      has_input = 1;
+    } else if(2 == sscanf(line, "schema %zu %zu %n", &r.begin, &r.end, &name_pos) && (0 < name_pos)) {
+      struct sql_table *tab = sql_index_get_table(&first, line + name_pos);
+      tab->schema = r;
+    } else if(3 == sscanf(line, "data %zu %zu %zu %n", &r.begin, &r.end, &r.rows, &name_pos) && (0 < name_pos)) {
+      struct sql_table *tab = sql_index_get_table(&first, line + name_pos);
+      tab->ranges = (struct sql_range*)sql_xrealloc(tab->ranges, (1 + tab->num_ranges) * sizeof(struct sql_range));
+      tab->ranges[tab->num_ranges] = r;
+      tab->num_ranges += 1;
+    } else {
+      /* Programmabbruch, da der Index beschädigt ist! */
+      sql_die("Invalid entry in index file `%s' in line %zu!", filename, lineno);
+    } /* if ... */
+  } /* while ... */
+
+  sql_xfree(line);
+  fclose(in);
+  return first;
+}
+
+void sql_index_parse_table(struct sql_context *p, FILE *in, const struct sql_table *q, const char *filename)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(in);
+  sql_check_nullptr(q);
+
+  if(q->schema.begin == q->schema.end) {
+    /* Programmabbruch, da die Tabelle nicht angelegt werden kann! */
+    sql_die("Index file `%s' has no schema for table `%s'!", filename, q->name);
+  } /* if ... */
+  sql_parse_range(p, in, &q->schema);
+
+  size_t i = 0;
+  for(; i < q->num_ranges; i += 1) {
+    sql_parse_range(p, in, q->ranges + i);
+  } /* for ... */
+}
+
+void sql_index_extract(struct sql_context *p, FILE *in, const char *filename)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(in);
+
+  struct sql_table *first = sql_index_read(in, filename);
+  struct sql_table *it = first;
+
+  for(; NULL != it; it = it->next) {
+    if(!sql_context_is_selected(p, it->name)) {
+      /* Die Tabelle wird übersprungen */
+      sql_debug("Skipping table `%s' by index...", it->name);
+      continue;
+    } /* if(!sql_context_is_selected ... ) */
+
+    sql_debug("Extracting table `%s' by index...", it->name);
+    sql_index_parse_table(p, in, it, filename);
+  } /* for ... */
+
+  while(NULL != first) {
+    struct sql_table *it_next = first->next;
+    sql_table_free(first);
+    first = it_next;
+  } /* while ... */
+}
@@ -24,21 +24,119 @@
 #include "sql_parser.h"
 #include "sql_scanner.h"
 #include <libgen.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
 
 /* Quelle: http://stackoverflow.com/a/32539752 */
 
+/* Ein Bereich beginnt beim ersten und endet beim letzten Token */
+#define YYLLOC_DEFAULT(cur, rhs, n) {\
+  if(0 < (n)) {\
+    (cur).first_byte = YYRHSLOC(rhs, 1).first_byte;\
+    (cur).last_byte = YYRHSLOC(rhs, n).last_byte;\
+  } else {\
+    (cur).first_byte = YYRHSLOC(rhs, 0).last_byte;\
+    (cur).last_byte = YYRHSLOC(rhs, 0).last_byte;\
+  }}
+
+/* Fehler in einer Anweisung: Abbruch oder Anweisung überspringen */
+#define sql_statement_error(...) {\
+  if(!ctx->skip_errors) {\
+    sql_die(__VA_ARGS__);\
+  }\
+  sql_warning(__VA_ARGS__);\
+  sql_scanner_skip_statement(scanner);}
+
+/* Spalte für den nächsten Wert einer Zeile holen */
+#define sql_get_value_column(col) {\
+  col = sql_context_get_current_column(ctx);\
+  if(NULL == col) {\
+    /* Es gibt mehr Werte als Spalten! */\
+    sql_statement_error("Too many values for table `%s'!", ctx->current_table->name);\
+    YYERROR;\
+  }\
+  sql_context_next_column(ctx);}
+
+/* Wert übernehmen; passt er nicht in die Spalte, ist die Anweisung fehlerhaft */
+#define sql_set_value(call, ...) {\
+  if(!(call)) {\
+    sql_statement_error(__VA_ARGS__);\
+    YYERROR;\
+  }}
+
 void sqlerror(YYLTYPE *bloc, struct sql_context *ctx, yyscan_t scanner, char const *msg)
 {
-  sql_die("In line %i: %s!", sqlget_lineno(scanner), msg);
+  if(!ctx->skip_errors) {
+    sql_die("In line %i: %s!", sqlget_lineno(scanner), msg);
+  } /* if(!ctx->skip_errors) */
+
+  sql_warning("In line %i: %s! Skipping statement...", sqlget_lineno(scanner), msg);
+  sql_scanner_skip_statement(scanner);
+}
+
+int sql_parse_range(struct sql_context *p, FILE *in, const struct sql_range *r)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(in);
+  sql_check_nullptr(r);
+
+  if(0 != fseeko(in, (off_t)r->begin, SEEK_SET)) {
+    /* Programmabbruch, da der Bereich nicht angesprungen werden kann! */
+    sql_die("Could not seek to byte %zu in `%s'! (Error: %m)", r->begin, p->source_file);
+  } /* if(0 != fseeko ... ) */
+
+  yyscan_t scanner;
+  p->offset = r->begin;
+  p->input_left = r->end - r->begin;
+  sqllex_init_extra(p, &scanner);
+  sqlset_in(in, scanner);
+  const int result = sqlparse(p, scanner);
+  sqllex_destroy(scanner);
+  p->input_left = SIZE_MAX;
+  return result;
 }
 
+/* Optionen ohne Kurzform */
+enum {
+  SQL_OPT_FLUSH_ROWS = 256,
+  SQL_OPT_FLUSH_BYTES,
+  SQL_OPT_FLUSH_MS
+};
+
+static const struct option sql_long_options[] = {
+  {"table",       required_argument, NULL, 'T'},
+  {"build-index", no_argument,       NULL, 'I'},
+  {"index",       no_argument,       NULL, 'x'},
+  {"incremental", required_argument, NULL, 'i'},
+  {"write-threads", required_argument, NULL, 'w'},
+  {"write-buffers", required_argument, NULL, 'W'},
+  {"direct",      no_argument,       NULL, 'D'},
+  {"skip-errors", no_argument,       NULL, 's'},
+  {"null",        required_argument, NULL, 'N'},
+  {"jobs",        required_argument, NULL, 'j'},
+  {"sample",      required_argument, NULL, 'r'},
+  {"sample-rows", required_argument, NULL, 'R'},
+  {"seed",        required_argument, NULL, 'S'},
+  {"column-stats", no_argument,      NULL, 'C'},
+  {"fd",          required_argument, NULL, 'F'},
+  {"flush-rows",  required_argument, NULL, SQL_OPT_FLUSH_ROWS},
+  {"flush-bytes", required_argument, NULL, SQL_OPT_FLUSH_BYTES},
+  {"flush-ms",    required_argument, NULL, SQL_OPT_FLUSH_MS},
+  {NULL, 0, NULL, 0}
+};
+
 int main(int argc, char *argv[])
 { 
   yyscan_t scanner;
   int opt;
   struct sql_context sql = sql_context_init();
+  size_t write_threads = 0;
+  size_t write_buffers = 0;
+  int write_direct = 0;
+  size_t jobs = 0;
   sql.source_file = "stdin";
-  while(-1 != (opt = getopt(argc, argv, "hqcdntf:o:"))) {
+  while(-1 != (opt = getopt_long(argc, argv, "hqcdntf:o:T:Ixi:w:W:DsN:j:r:R:S:CF:", sql_long_options, NULL))) {
     switch(opt) {
       case 'h':
         printf("Usage: %s OPT FILE...\n", basename(argv[0]));
@@ -54,7 +152,41 @@ int main(int argc, char *argv[])
         printf(" -n      Insert column names as first line.\n");
         printf(" -t      Insert column types as comment.\n");
         printf(" -f FMT  Set print format for float values.\n");
+        printf(" -N STR, --null STR\n");
+        printf("         Print STR for NULL values (default: empty).\n");
         printf(" -o DIR  Use DIR as output directory.\n");
+        printf(" -T TAB, --table TAB\n");
+        printf("         Only convert table TAB. May be given more than once.\n");
+        printf(" -I, --build-index\n");
+        printf("         Write byte offsets of all tables to FILE.idx.\n");
+        printf(" -x, --index\n");
+        printf("         Read only the selected tables using FILE.idx (FILE must be unchanged).\n");
+        printf(" -i STATE, --incremental STATE\n");
+        printf("         Only convert tables whose dump text changed since the run\n");
+        printf("         that wrote STATE; other output files are kept.\n");
+        printf(" -w N, --write-threads N\n");
+        printf("         Write uncompressed tables asynchronously via io_uring\n");
+        printf("         (or N threads with pwrite if io_uring is unavailable).\n");
+        printf(" -W N, --write-buffers N\n");
+        printf("         Use at most N output buffers of 1 MiB (default: 4 per thread).\n");
+        printf(" -D, --direct\n");
+        printf("         Bypass the page cache (O_DIRECT) when writing asynchronously.\n");
+        printf(" -j N, --jobs N\n");
+        printf("         Format, compress and write rows with N threads while parsing.\n");
+        printf(" -r RATE, --sample RATE\n");
+        printf("         Only convert each row with probability RATE (0 < RATE <= 1).\n");
+        printf(" -R N, --sample-rows N\n");
+        printf("         Only convert N randomly chosen rows per table.\n");
+        printf(" -S SEED, --seed SEED\n");
+        printf("         Seed for sampling (default: fixed, output is reproducible).\n");
+        printf(" -C, --column-stats\n");
+        printf("         Write min/max, null and distinct counts of each table to FILE.stats.json.\n");
+        printf(" -F TAB=FD, --fd TAB=FD\n");
+        printf("         Write table TAB to the open file descriptor FD.\n");
+        printf(" --flush-rows N, --flush-bytes N, --flush-ms N\n");
+        printf("         Streaming: Flush tables every N rows, N bytes or N ms.\n");
+        printf(" -s, --skip-errors\n");
+        printf("         Skip invalid statements instead of terminating.\n");
         printf("\n");
         printf("Copyright 2016, rbnn\n");
         printf("Compiled: %s %s\n", __DATE__, __TIME__);
@@ -84,15 +216,120 @@ int main(int argc, char *argv[])
         sql_debug("Changing float format to `%s'...", optarg);
         sql.float_fmt = optarg;
         break;
+      case 'N':
+        sql_debug("Changing null token to `%s'...", optarg);
+        sql.null_token = optarg;
+        break;
       case 'o':
         sql_debug("Changing output directory to `%s'...", optarg);
         sql.out_dir = optarg;
         break;
+      case 'T':
+        sql_debug("Selecting table `%s'...", optarg);
+        sql_context_select_table(&sql, optarg);
+        break;
+      case 'I':
+        sql_debug("Enabling index creation...");
+        sql.build_index = 1;
+        break;
+      case 'x':
+        sql_debug("Enabling index lookup...");
+        sql.use_index = 1;
+        break;
+      case 'i':
+        sql_debug("Using state file `%s'...", optarg);
+        sql.state_file = optarg;
+        break;
+      case 'w':
+        sql_debug("Using %s writer threads...", optarg);
+        write_threads = sql_parse_count("-w", optarg, 1, 256);
+        break;
+      case 'W':
+        sql_debug("Using %s write buffers...", optarg);
+        write_buffers = sql_parse_count("-W", optarg, 1, 4096);
+        break;
+      case 'D':
+        sql_debug("Enabling direct I/O...");
+        write_direct = 1;
+        break;
+      case 's':
+        sql_debug("Skipping invalid statements...");
+        sql.skip_errors = 1;
+        break;
+      case 'r':
+        sql_debug("Sampling rows with rate %s...", optarg);
+        sql.sample_rate = strtod(optarg, NULL);
+        if(!(0.0 < sql.sample_rate) || (1.0 < sql.sample_rate)) {
+          /* Programmabbruch, da die Rate keine Wahrscheinlichkeit ist! */
+          sql_die("Invalid sample rate `%s'!", optarg);
+        } /* if ... */
+        break;
+      case 'R':
+        sql_debug("Sampling %s rows per table...", optarg);
+        sql.sample_rows = sql_parse_count("-R", optarg, 1, SIZE_MAX / sizeof(struct sql_sample));
+        break;
+      case 'S':
+        sql_debug("Using seed %s...", optarg);
+        sql.seed = strtoull(optarg, NULL, 0);
+        if(0 == sql.seed) {
+          /* xorshift bleibt bei 0 stehen */
+          sql.seed = 1;
+        } /* if(0 == sql.seed) */
+        break;
+      case 'C':
+        sql_debug("Collecting column statistics...");
+        sql.column_stats = 1;
+        break;
+      case 'F':
+        sql_debug("Adding output `%s'...", optarg);
+        sql_context_add_output(&sql, optarg);
+        break;
+      case SQL_OPT_FLUSH_ROWS:
+        sql_debug("Flushing every %s rows...", optarg);
+        sql.flush_rows = sql_parse_count("--flush-rows", optarg, 1, SIZE_MAX);
+        break;
+      case SQL_OPT_FLUSH_BYTES:
+        sql_debug("Flushing every %s bytes...", optarg);
+        sql.flush_bytes = sql_parse_count("--flush-bytes", optarg, 1, 1 << 30);
+        break;
+      case SQL_OPT_FLUSH_MS:
+        sql_debug("Flushing every %s ms...", optarg);
+        sql.flush_ms = sql_parse_count("--flush-ms", optarg, 1, 24 * 60 * 60 * 1000);
+        break;
+      case 'j':
+        sql_debug("Using %s pipeline threads...", optarg);
+        jobs = sql_parse_count("-j", optarg, 1, 256);
+        break;
       default:
         /* Programmabbruch, da die Option unbekannt war! */
         sql_die("Invalid option `-%c'!", opt);
     } /* switch(opt) */
   } /* while */
+
+  if((NULL != sql.state_file) && (sql.use_index || sql.build_index)) {
+    /* Programmabbruch, da der Index nur einen Teil der Tabellen enthielte! */
+    sql_die("Incremental conversion cannot be combined with an index!");
+  } /* if ... */
+
+  if((NULL != sql.state_file) && sql.dont_drop) {
+    /* Programmabbruch, da geänderte Tabellen doppelt angehängt würden! */
+    sql_die("Incremental conversion cannot be combined with `-d'!");
+  } /* if ... */
+
+  if(0 < write_threads) {
+    /* Asynchrone Ausgabe starten */
+    sql_writer_init(write_threads, (0 < write_buffers) ? write_buffers : 4 * write_threads, 1 << 20, write_direct);
+  } /* if(0 < write_threads) */
+
+  if(0 < jobs) {
+    /* Formatieren und Schreiben vom Parsen trennen */
+    sql_pipeline_init(jobs);
+  } /* if(0 < jobs) */
+
+  if(0 < sql.flush_ms) {
+    /* Ausgabe regelmäßig leeren */
+    sql_flusher_init(sql.flush_ms);
+  } /* if(0 < sql.flush_ms) */
   
   for(; optind < argc; optind += 1) {
     FILE *f_in = NULL;
@@ -108,16 +345,42 @@ int main(int argc, char *argv[])
       ctx.source_file = fname;
     } /* if(0 == strcmp ... ) */
 
-    sql_check_nullptr(f_in);
+    if(NULL == f_in) {
+      /* Programmabbruch, da die Eingabe nicht geöffnet werden konnte! */
+      sql_die("Could not open file `%s'! (Error: %m)", fname);
+    } /* if(NULL == f_in) */
 
-    sqllex_init(&scanner);
-    sqlset_in(f_in, scanner);
-    if(0 == sqlparse(&ctx, scanner)) {
-      /* Parsen war erfolgreich */
-      sql_debug("Conversion to csv was successful.");
-    } /* if(0 == sqlparse ... ) */
+    char idx_filename[2 * PATH_MAX] = {0};
+    sql_index_get_filename(&ctx, idx_filename, sizeof(idx_filename));
 
-    sqllex_destroy(scanner);
+    if(ctx.use_index) {
+      if(f_in == stdin) {
+        /* Programmabbruch, da in der Eingabe nicht gesprungen werden kann! */
+        sql_die("Index lookup requires a seekable input file!");
+      } /* if(f_in == stdin) */
+      sql_index_extract(&ctx, f_in, idx_filename);
+    } else if(NULL != ctx.state_file) {
+      if(f_in == stdin) {
+        /* Programmabbruch, da in der Eingabe nicht gesprungen werden kann! */
+        sql_die("Incremental conversion requires a seekable input file!");
+      } /* if(f_in == stdin) */
+      sql_incremental_run(&ctx, f_in);
+    } else {
+      sqllex_init_extra(&ctx, &scanner);
+      sqlset_in(f_in, scanner);
+      if(0 == sqlparse(&ctx, scanner)) {
+        /* Parsen war erfolgreich */
+        sql_debug("Conversion to csv was successful.");
+      } /* if(0 == sqlparse ... ) */
+      sqllex_destroy(scanner);
+
+      if(ctx.build_index) {
+        /* Index neben die Ausgabe schreiben */
+        sql_index_write(&ctx, f_in, idx_filename);
+      } /* if(ctx.build_index) */
+    } /* if(ctx.use_index) */
+
+    sql_context_report_skipped(&ctx);
     sql_context_destroy(&ctx);
 
     if(0 != strcmp("-", fname)) {
@@ -125,6 +388,11 @@ int main(int argc, char *argv[])
     } /* if(0 != strcmp ... ) */
   } /* for... */
   sql_context_destroy(&sql);
+  sql_xfree(sql.tables);
+  sql_xfree(sql.outputs);
+  sql_flusher_shutdown();
+  sql_pipeline_shutdown();
+  sql_writer_shutdown();
   return 0;
 }
 
@@ -136,6 +404,7 @@ int main(int argc, char *argv[])
 %output "sql_parser.c"
 %defines "sql_parser.h"
 %locations
+%define api.location.type {struct sql_location}
 %error-verbose
 %define api.pure full
 %define api.prefix {sql}
@@ -146,26 +415,41 @@ int main(int argc, char *argv[])
 
 %union {
   long long   int_value;
-  long double flt_value;
   char       *str_value;
+  struct sql_number number;
+  struct sql_text text_value;
   struct obstack os;
   struct sql_column *new_column;
   struct sql_table *new_table;
 }
 
-%token <int_value> INT
-%token <flt_value> FLOAT
+%token <int_value> INT TYPE
+%token <number> FLOAT
 %token <str_value> STRING ID
-%token LPAREN RPAREN SEMICOLON COMMA SETTO
+%token <text_value> TEXT HEX
+%token LPAREN RPAREN SEMICOLON COMMA SETTO UNKNOWN SKIPPED_ROW
 %token KW_CREATE KW_DEFAULT KW_DROP KW_EXISTS
 %token KW_IF KW_INSERT KW_INTO KW_KEY KW_LOCK
 %token KW_NOT KW_NULL KW_PRIMARY KW_TABLE KW_TABLES 
 %token KW_UNLOCK KW_VALUES KW_WRITE
+%token KW_SET KW_SKIP
 
-%token KW_INT KW_UNSIGNED
+%token KW_UNSIGNED
 
+%type <int_value> create_table_column_type
 %type <new_table> create_table_statement
-%type <new_column> create_table_columns_statement create_table_column_statement insert_into_values_columns
+%type <new_column> create_table_columns_statement create_table_column_statement
+
+%destructor { sql_xfree($$); } <str_value>
+%destructor {
+  struct sql_column *it = sql_column_get_first_sibbling($$);
+  while(NULL != it) {
+    struct sql_column *it_next = it->next;
+    sql_column_free(it);
+    it = it_next;
+  } /* while ... */
+} <new_column>
+%destructor { sql_table_free($$); } <new_table>
 %%
 sequence_of_statements:
   {
@@ -197,26 +481,57 @@ statement:
   create_table_statement SEMICOLON
   {
     sql_debug("Found create-table statement...");
+    $1->schema.begin = @$.first_byte;
+    $1->schema.end = @$.last_byte;
     sql_context_add_table(ctx, $1);
   }
   |
   lock_table_statement SEMICOLON
   {
     sql_debug("Found lock-table statement...");
-    /* Nix weiter */
+    sql_table_begin_range(ctx->current_table, @$.first_byte);
   }
   |
   unlock_table_statement SEMICOLON
   {
     sql_debug("Found unlock-table statement...");
-    /* Nix weiter */
+    if(NULL != ctx->current_table) {
+      /* Bereich der Tabelle abschließen */
+      sql_table_end_range(ctx->current_table, @$.last_byte);
+    } /* if(NULL != ctx->current_table) */
+    sql_context_unlock_table(ctx);
   }
   |
   insert_into_statement SEMICOLON
   {
     sql_debug("Found insert statement...");
-    /* Nix weiter */
+    ctx->in_insert = 0;
+    ctx->insert_table = NULL;
+  }
+  |
+  skip_statement_keyword
+  {
+    /* Nicht unterstützte Anweisungen werden ohne Parsen übersprungen */
+    sql_scanner_skip_statement(scanner);
   }
+  SEMICOLON
+  {
+    sql_debug("Skipped unsupported statement...");
+    ctx->skip_rows = 0;
+  }
+  |
+  error SEMICOLON
+  {
+    sql_debug("Skipped invalid statement...");
+    sql_context_skip_statement(ctx);
+    yyerrok;
+  }
+  ;
+
+skip_statement_keyword:
+  KW_SET
+  |
+  KW_SKIP
   ;
 
 drop_table_statement:
@@ -231,6 +546,19 @@ drop_table_statement:
 create_table_statement:
   KW_CREATE KW_TABLE STRING LPAREN create_table_columns_statement RPAREN
   {
+    if(NULL != sql_context_get_table(ctx, $3)) {
+      /* Die Tabelle existiert bereits! */
+      sql_statement_error("Table `%s' already exists!", $3);
+      struct sql_column *it = sql_column_get_first_sibbling($5);
+      while(NULL != it) {
+        struct sql_column *it_next = it->next;
+        sql_column_free(it);
+        it = it_next;
+      } /* while ... */
+      sql_xfree($3);
+      YYERROR;
+    } /* if(NULL != sql_context_get_table ... ) */
+
     $$ = sql_table_new();
     sql_table_set_name($$, $3);
     $$->first_column = sql_column_get_first_sibbling($5);
@@ -240,11 +568,13 @@ create_table_statement:
   |
   create_table_statement KW_DEFAULT
   {
+    $$ = $1;
     sql_warning("Ignoring `default' keyword for table!");
   }
   |
   create_table_statement ID SETTO ID
   {
+    $$ = $1;
     sql_warning("Ignoring `%s=%s' for table!", $2, $4);
     sql_xfree($4);
     sql_xfree($2);
@@ -252,9 +582,17 @@ create_table_statement:
   |
   create_table_statement ID SETTO INT
   {
+    $$ = $1;
     sql_warning("Ignoring `%s=%lli' for table!", $2, $4);
     sql_xfree($2);
   }
+  |
+  create_table_statement ID SETTO TEXT
+  {
+    $$ = $1;
+    sql_warning("Ignoring `%s' for table!", $2);
+    sql_xfree($2);
+  }
   ;
 
 create_table_columns_statement:
@@ -269,63 +607,218 @@ create_table_columns_statement:
     $$ = sql_column_get_last_sibbling($3);
   }
   |
-  create_table_columns_statement COMMA create_table_primary_key_statement
+  create_table_columns_statement COMMA create_table_key_statement
   {
-    sql_warning("Ignorig primary key definition!");
+    $$ = $1;
+    sql_warning("Ignoring key definition!");
   }
   ;
 
 create_table_column_statement:
-  STRING KW_INT LPAREN INT RPAREN
+  STRING create_table_column_type
   {
     $$ = sql_column_new();
     sql_column_set_name($$, $1);
-    sql_column_set_int($$, 0L);
+    sql_column_set_type($$, (enum sql_column_type)$2);
     sql_xfree($1);
   }
   |
   create_table_column_statement KW_UNSIGNED
   {
-    sql_warning("Ignoring `unsigned' for column!");
+    $$ = $1;
+    sql_column_set_unsigned($$);
   }
   |
   create_table_column_statement KW_NOT KW_NULL
   {
+    $$ = $1;
     sql_warning("Ignoring `not null' for column!");
   }
   |
-  create_table_column_statement KW_DEFAULT KW_NULL
+  create_table_column_statement KW_NULL
   {
-    sql_warning("Ignoring `default null' for column!");
+    $$ = $1;
+    sql_warning("Ignoring `null' for column!");
+  }
+  |
+  create_table_column_statement KW_DEFAULT create_table_default_value
+  {
+    $$ = $1;
+    sql_warning("Ignoring default value for column!");
   }
   |
   create_table_column_statement ID
   {
+    $$ = $1;
     sql_warning("Ignoring `%s' for column!", $2);
     sql_xfree($2);
   }
+  |
+  create_table_column_statement ID LPAREN RPAREN
+  {
+    $$ = $1;
+    sql_warning("Ignoring `%s()' for column!", $2);
+    sql_xfree($2);
+  }
+  |
+  create_table_column_statement ID LPAREN INT RPAREN
+  {
+    $$ = $1;
+    sql_warning("Ignoring `%s(%lli)' for column!", $2, $4);
+    sql_xfree($2);
+  }
+  |
+  create_table_column_statement KW_SET
+  {
+    $$ = $1;
+    sql_warning("Ignoring `set' for column!");
+  }
+  |
+  create_table_column_statement TYPE
+  {
+    $$ = $1;
+    sql_warning("Ignoring `%s' for column!", sql_column_get_type_name((enum sql_column_type)$2));
+  }
+  |
+  create_table_column_statement TEXT
+  {
+    $$ = $1;
+    sql_warning("Ignoring `'%s'' for column!", $2.str);
+  }
+  ;
+
+create_table_column_type:
+  TYPE
+  {
+    $$ = $1;
+  }
+  |
+  TYPE LPAREN INT RPAREN
+  {
+    $$ = $1;
+  }
+  |
+  TYPE LPAREN INT COMMA INT RPAREN
+  {
+    $$ = $1;
+  }
+  |
+  TYPE LPAREN create_table_text_list RPAREN
+  {
+    /* enum('a','b',...) */
+    $$ = $1;
+  }
+  |
+  KW_SET LPAREN create_table_text_list RPAREN
+  {
+    /* Mengen werden wie Aufzählungen als Text ausgegeben */
+    $$ = sql_column_type_enum;
+  }
+  ;
+
+create_table_text_list:
+  TEXT
+  |
+  create_table_text_list COMMA TEXT
+  ;
+
+create_table_default_value:
+  KW_NULL
+  |
+  INT
+  |
+  FLOAT
+  |
+  TEXT
+  |
+  HEX
+  |
+  ID
+  {
+    sql_xfree($1);
+  }
+  |
+  ID LPAREN RPAREN
+  {
+    sql_xfree($1);
+  }
+  |
+  ID LPAREN INT RPAREN
+  {
+    sql_xfree($1);
+  }
+  ;
+
+create_table_key_statement:
+  KW_PRIMARY KW_KEY create_table_key_tokens
+  |
+  KW_KEY create_table_key_tokens
+  |
+  ID create_table_key_tokens
+  {
+    /* UNIQUE, FULLTEXT, CONSTRAINT, ... */
+    sql_xfree($1);
+  }
   ;
 
-create_table_primary_key_statement:
-  KW_PRIMARY KW_KEY LPAREN create_table_primary_key_column_list RPAREN
+create_table_key_tokens:
+  {
+    /* Nix weiter */
+  }
+  |
+  create_table_key_tokens create_table_key_token
   ;
 
-create_table_primary_key_column_list:
+create_table_key_token:
   STRING
   {
     sql_xfree($1);
   }
   |
-  create_table_primary_key_column_list COMMA STRING
+  ID
   {
-    sql_xfree($3);
+    sql_xfree($1);
   }
+  |
+  INT
+  |
+  TEXT
+  |
+  KW_KEY
+  |
+  KW_SET
+  |
+  KW_NULL
+  |
+  KW_DEFAULT
+  |
+  SETTO
+  |
+  LPAREN create_table_key_list RPAREN
+  ;
+
+create_table_key_list:
+  create_table_key_tokens
+  |
+  create_table_key_list COMMA create_table_key_tokens
   ;
 
 lock_table_statement:
   KW_LOCK KW_TABLES STRING KW_WRITE
   {
     sql_debug("Locking table `%s'...", $3);
+    if(NULL != ctx->current_table) {
+      /* Es wurde bereits eine Tabelle gewählt! */
+      sql_statement_error("Context already has locked table `%s'!", ctx->current_table->name);
+      sql_xfree($3);
+      YYERROR;
+    } /* if(NULL != ctx->current_table) */
+    if(NULL == sql_context_get_table(ctx, $3)) {
+      /* Die Tabelle wurde nicht angelegt! */
+      sql_statement_error("Could not lock table `%s'! No such table!", $3);
+      sql_xfree($3);
+      YYERROR;
+    } /* if(NULL == sql_context_get_table ... ) */
     sql_context_lock_table(ctx, $3);
     sql_xfree($3);
   }
@@ -335,22 +828,37 @@ unlock_table_statement:
   KW_UNLOCK KW_TABLES
   {
     sql_debug("Releasing current table...");
-    sql_context_unlock_table(ctx);
+    /* Die Tabelle wird erst nach dem Semikolon freigegeben */
   }
   ;
 
 insert_into_statement:
-  KW_INSERT KW_INTO STRING KW_VALUES insert_into_values_rows
+  insert_into_head insert_into_values_rows
+  ;
+
+insert_into_head:
+  KW_INSERT
+  {
+    /* Übersprungene Zeilen werden ab hier gezählt */
+    ctx->in_insert = 1;
+    ctx->insert_table = ctx->current_table;
+  }
+  KW_INTO STRING KW_VALUES
   {
+    ctx->insert_table = sql_context_get_table(ctx, $4);
     if(NULL == ctx->current_table) {
-      /* Programmabbruch, da die Tabelle nicht gewählt wurde! */
-      sql_die("Table `%s' must be locked prior to use!", $3);
+      /* Die Tabelle wurde nicht gewählt! */
+      sql_statement_error("Table `%s' must be locked prior to use!", $4);
+      sql_xfree($4);
+      YYERROR;
     } /* if(NULL == current_table) */
-    if(0 != strcmp(ctx->current_table->name, $3)) {
-      /* Programmabbruch, da die falsche Tabelle gewählt wurde! */
-      sql_die("Invalid write detected! Table `%s' must be locked prior to use! (currently locked: `%s')", $3, ctx->current_table->name);
+    if(0 != strcmp(ctx->current_table->name, $4)) {
+      /* Die falsche Tabelle wurde gewählt! */
+      sql_statement_error("Invalid write detected! Table `%s' must be locked prior to use! (currently locked: `%s')", $4, ctx->current_table->name);
+      sql_xfree($4);
+      YYERROR;
     } /* if(0 != strcmp ... ) */
-    sql_xfree($3);
+    sql_xfree($4);
   }
   ;
 
@@ -367,32 +875,76 @@ insert_into_values_rows:
     sql_debug("Writing row into table `%s'...", ctx->current_table->name);
     sql_context_write_current_row(ctx);
   }
+  |
+  SKIPPED_ROW
+  {
+    sql_check_nullptr(ctx->current_table);
+    sql_context_skip_row(ctx);
+  }
+  |
+  insert_into_values_rows COMMA SKIPPED_ROW
+  {
+    sql_context_skip_row(ctx);
+  }
   ;
 
 insert_into_values_row:
   LPAREN insert_into_values_columns RPAREN
+  {
+    if(NULL != sql_context_get_current_column(ctx)) {
+      /* Es fehlen Werte! */
+      sql_statement_error("Too few values for table `%s'!", ctx->current_table->name);
+      ctx->skip_rows += 1;
+      YYERROR;
+    } /* if(NULL != ... ) */
+  }
   ;
 
 insert_into_values_columns:
+  insert_into_values_column
+  |
+  insert_into_values_columns COMMA insert_into_values_column
+  ;
+
+insert_into_values_column:
   INT
   {
-    struct sql_column *col = sql_context_get_current_column(ctx);
-    sql_context_next_column(ctx);
-    sql_column_set_int(col, $1);
+    struct sql_column *col = NULL;
+    sql_get_value_column(col);
+    sql_set_value(sql_column_set_int(col, $1), "Value %lli is out of range for column `%s'!", $1, col->name);
   }
   |
   FLOAT
   {
-    struct sql_column *col = sql_context_get_current_column(ctx);
-    sql_context_next_column(ctx);
-    sql_column_set_float(col, $1);
+    struct sql_column *col = NULL;
+    if(SQL_NUMBER_SIZE <= $1.size) {
+      /* Die Zahl passt nicht in den Puffer des Scanners */
+      sql_statement_error("Number `%s' in line %i is too long!", $1.text, sqlget_lineno(scanner));
+      YYERROR;
+    } /* if(SQL_NUMBER_SIZE <= $1.size) */
+    sql_get_value_column(col);
+    sql_set_value(sql_column_set_number(col, $1.text, $1.size), "Value `%s' is out of range for column `%s'!", $1.text, col->name);
+  }
+  |
+  TEXT
+  {
+    struct sql_column *col = NULL;
+    sql_get_value_column(col);
+    sql_set_value(sql_column_set_text(col, $1.str, $1.size), "Value `%.*s' is out of range for column `%s'!", (int)$1.size, $1.str, col->name);
+  }
+  |
+  HEX
+  {
+    struct sql_column *col = NULL;
+    sql_get_value_column(col);
+    sql_set_value(sql_column_set_binary(col, $1.str, $1.size), "Binary value is out of range for column `%s'!", col->name);
   }
   |
-  insert_into_values_columns COMMA INT
+  KW_NULL
   {
-    struct sql_column *col = sql_context_get_current_column(ctx);
-    sql_context_next_column(ctx);
-    sql_column_set_int(col, $3);
+    struct sql_column *col = NULL;
+    sql_get_value_column(col);
+    sql_column_set_null(col);
   }
   ;
 %%
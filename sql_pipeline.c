@@ -0,0 +1,523 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef SQL_ZLIB
+#include <zlib.h>
+#endif /* SQL_ZLIB */
+
+/* Parallele Ausgabe (Pipeline):
+ * Der Parser kopiert die Werte jeder Zeile in einen Stapel seiner Tabelle.
+ * Volle Stapel werden je Tabelle fortlaufend nummeriert und in eine
+ * gemeinsame Warteschlange gestellt. Jeder Thread des Pools kann einen
+ * Stapel formatieren und (mit -c) als eigenständigen gzip-Block
+ * komprimieren. Geschrieben wird ein Stapel erst, wenn alle Stapel mit
+ * kleinerer Nummer geschrieben sind: Der Thread, der die nächste Nummer
+ * fertigstellt, schreibt sie und alle direkt folgenden fertigen Stapel.
+ * Je Tabelle sind höchstens sql_pipeline_pool.window Stapel unterwegs.
+ * Beim Entsperren wird die Pipeline geleert und freigegeben; Stapel besitzt
+ * nur die gesperrte Tabelle.
+ */
+
+#define SQL_PIPELINE_BATCH_SIZE  (256 << 10)
+
+struct sql_pipeline;
+
+struct sql_pipeline_batch {
+  char   *data;
+  size_t  used;
+  size_t  capacity;
+  /* -- Formatierte bzw. komprimierte Zeilen -- */
+  char   *text;
+  size_t  text_size;
+  size_t  text_capacity;
+  size_t  seq;
+  int     flush;
+  int     done;
+  struct sql_pipeline       *owner;
+  struct sql_pipeline_batch *next;
+}; /* struct sql_pipeline_batch */
+
+struct sql_pipeline {
+  struct sql_table           *table;
+  struct sql_pipeline_batch  *current;
+  struct sql_pipeline_batch  *free_batches;
+  struct sql_pipeline_batch **window;
+  size_t                      next_seq;
+  size_t                      commit_seq;
+  int                         committing;
+  unsigned int                epoch;
+}; /* struct sql_pipeline */
+
+/* Wird vom Flusher erhöht, damit angefangene Stapel weitergereicht werden */
+static atomic_uint sql_pipeline_epoch = 0;
+
+static struct {
+  pthread_mutex_t            lock;
+  pthread_cond_t             has_job;
+  pthread_cond_t             has_done;
+  pthread_t                 *threads;
+  size_t                     num_threads;
+  size_t                     window;
+  int                        shutdown;
+  struct sql_pipeline_batch *first_job;
+  struct sql_pipeline_batch *last_job;
+} sql_pipeline_pool = {
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  NULL, 0, 0, 0, NULL, NULL
+};
+
+static struct sql_pipeline_batch *sql_pipeline_batch_new(void)
+{
+  struct sql_pipeline_batch *b = (struct sql_pipeline_batch*)sql_xmalloc(sizeof(struct sql_pipeline_batch));
+  b->capacity = SQL_PIPELINE_BATCH_SIZE;
+  b->data = (char*)sql_xmalloc(b->capacity);
+  b->used = 0;
+  b->text = NULL;
+  b->text_size = 0;
+  b->text_capacity = 0;
+  b->seq = 0;
+  b->flush = 0;
+  b->done = 0;
+  b->owner = NULL;
+  b->next = NULL;
+  return b;
+}
+
+static void sql_pipeline_batch_free(struct sql_pipeline_batch *p)
+{
+  if(NULL != p) {
+    sql_xfree(p->data);
+    sql_xfree(p->text);
+    sql_xfree(p);
+  } /* if(NULL != p) */
+}
+
+static void sql_pipeline_batch_append(struct sql_pipeline_batch *p, const void *x, size_t n)
+{
+  if(p->capacity < p->used + n) {
+    /* Eine einzelne Zeile darf den Stapel vergrößern */
+    p->capacity = 2 * (p->used + n);
+    p->data = (char*)sql_xrealloc(p->data, p->capacity);
+  } /* if ... */
+
+  memcpy(p->data + p->used, x, n);
+  p->used += n;
+}
+
+static void sql_pipeline_batch_reserve(struct sql_pipeline_batch *p, size_t n)
+{
+  if(p->text_capacity < n) {
+    p->text_capacity = n;
+    p->text = (char*)sql_xrealloc(p->text, p->text_capacity);
+  } /* if(p->text_capacity < n) */
+}
+
+/* Formatiert alle Zeilen eines Stapels nach OUT (läuft im Thread-Pool). */
+static void sql_pipeline_batch_format(struct sql_pipeline_batch *p, struct sql_table *t, FILE *out)
+{
+  const char *it = p->data;
+  const char *end = p->data + p->used;
+
+  while(it != end) {
+    int is_first_column = 1;
+    struct sql_column *col = t->first_column;
+
+    for(; NULL != col; col = col->next) {
+      if(!is_first_column) {
+        fputc_unlocked(',', out);
+      } /* if(!is_first_column) */
+      is_first_column = 0;
+
+      struct sql_value v;
+      v.is_null = *it++;
+      if(v.is_null) {
+        fputs_unlocked(t->null_token, out);
+        continue;
+      } /* if(v.is_null) */
+
+      switch(col->type) {
+        case sql_column_type_int:
+          memcpy(&v.int_value, it, sizeof(v.int_value));
+          it += sizeof(v.int_value);
+          break;
+        case sql_column_type_float:
+          memcpy(&v.flt_value, it, sizeof(v.flt_value));
+          it += sizeof(v.flt_value);
+          break;
+        default:
+          memcpy(&v.str_size, it, sizeof(v.str_size));
+          it += sizeof(v.str_size);
+          v.str_value = (char*)it;
+          it += v.str_size;
+          break;
+      } /* switch(col->type) */
+      col->write(out, &v, t);
+    } /* for ... */
+
+    fputc_unlocked('\n', out);
+  } /* while(it != end) */
+}
+
+/* Zustand eines Threads im Pool */
+struct sql_pipeline_worker {
+  FILE   *out;
+  char   *buffer;
+  size_t  size;
+  #ifdef SQL_ZLIB
+  z_stream zs;
+  int      has_zs;
+  #endif /* SQL_ZLIB */
+}; /* struct sql_pipeline_worker */
+
+/* Formatiert den Stapel und komprimiert ihn, falls die Tabelle das will. */
+static void sql_pipeline_batch_prepare(struct sql_pipeline_batch *p, struct sql_pipeline_worker *w)
+{
+  struct sql_table *t = p->owner->table;
+
+  rewind(w->out);
+  sql_pipeline_batch_format(p, t, w->out);
+  if(0 != fflush(w->out)) {
+    /* Programmabbruch, da kein Speicher vorhanden ist! */
+    sql_die("Could not format rows of table `%s'! (Error: %m)", t->name);
+  } /* if(0 != fflush(w->out)) */
+
+  #ifdef SQL_ZLIB
+  if(NULL != t->zfile) {
+    /* Jeder Stapel wird ein eigener gzip-Block; gzip liest sie am Stück */
+    if(!w->has_zs) {
+      memset(&w->zs, 0, sizeof(w->zs));
+      if(Z_OK != deflateInit2(&w->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY)) {
+        /* Programmabbruch, da kein Speicher vorhanden ist! */
+        sql_die("Could not initialize compression!");
+      } /* if(Z_OK != deflateInit2 ... ) */
+      w->has_zs = 1;
+    } else {
+      deflateReset(&w->zs);
+    } /* if(!w->has_zs) */
+
+    sql_pipeline_batch_reserve(p, deflateBound(&w->zs, w->size));
+    w->zs.next_in = (Bytef*)w->buffer;
+    w->zs.avail_in = w->size;
+    w->zs.next_out = (Bytef*)p->text;
+    w->zs.avail_out = p->text_capacity;
+    if(Z_STREAM_END != deflate(&w->zs, Z_FINISH)) {
+      /* Programmabbruch, da deflateBound() nicht reichte! */
+      sql_die("Could not compress rows of table `%s'!", t->name);
+    } /* if(Z_STREAM_END != deflate ... ) */
+    p->text_size = p->text_capacity - w->zs.avail_out;
+    return;
+  } /* if(NULL != t->zfile) */
+  #endif /* SQL_ZLIB */
+
+  sql_pipeline_batch_reserve(p, w->size);
+  memcpy(p->text, w->buffer, w->size);
+  p->text_size = w->size;
+}
+
+/* Schreibt alle fertigen Stapel in der Reihenfolge ihrer Nummern. Wird mit
+ * gesperrtem Pool aufgerufen; die Sperre ist nur beim Schreiben frei.
+ */
+static void sql_pipeline_commit(struct sql_pipeline *q)
+{
+  q->committing = 1;
+  for(;;) {
+    const size_t slot = q->commit_seq % sql_pipeline_pool.window;
+    struct sql_pipeline_batch *b = q->window[slot];
+    if((NULL == b) || !b->done) {
+      /* Der nächste Stapel fehlt noch */
+      break;
+    } /* if ... */
+    pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+    sql_table_write_block(q->table, b->text, b->text_size);
+    if(b->flush) {
+      /* Streaming: Die Zeilen sollen sofort lesbar sein */
+      sql_table_flush(q->table);
+    } /* if(b->flush) */
+
+    pthread_mutex_lock(&sql_pipeline_pool.lock);
+    q->window[slot] = NULL;
+    q->commit_seq += 1;
+    b->next = q->free_batches;
+    q->free_batches = b;
+  } /* for ... */
+  q->committing = 0;
+
+  /* Der Parser wartet womöglich auf einen freien Platz */
+  pthread_cond_broadcast(&sql_pipeline_pool.has_done);
+}
+
+static void *sql_pipeline_thread(void *arg)
+{
+  (void)arg;
+  struct sql_pipeline_worker w;
+  w.buffer = NULL;
+  w.size = 0;
+  #ifdef SQL_ZLIB
+  w.has_zs = 0;
+  #endif /* SQL_ZLIB */
+  if(NULL == (w.out = open_memstream(&w.buffer, &w.size))) {
+    /* Programmabbruch, da kein Speicher vorhanden ist! */
+    sql_die("Could not open memory stream! (Error: %m)");
+  } /* if(NULL == ... open_memstream ... ) */
+
+  pthread_mutex_lock(&sql_pipeline_pool.lock);
+  for(;;) {
+    while((NULL == sql_pipeline_pool.first_job) && !sql_pipeline_pool.shutdown) {
+      pthread_cond_wait(&sql_pipeline_pool.has_job, &sql_pipeline_pool.lock);
+    } /* while ... */
+
+    struct sql_pipeline_batch *b = sql_pipeline_pool.first_job;
+    if(NULL == b) {
+      /* Der Pool wird beendet */
+      break;
+    } /* if(NULL == b) */
+
+    sql_pipeline_pool.first_job = b->next;
+    if(NULL == sql_pipeline_pool.first_job) {
+      sql_pipeline_pool.last_job = NULL;
+    } /* if(NULL == ... first_job) */
+    pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+    sql_pipeline_batch_prepare(b, &w);
+
+    /* Der Stapel ist fertig. Schreibt gerade niemand, übernimmt dieser
+     * Thread; sonst sieht der Schreibende den Stapel vor seinem Ende.
+     */
+    pthread_mutex_lock(&sql_pipeline_pool.lock);
+    b->done = 1;
+    if(!b->owner->committing) {
+      sql_pipeline_commit(b->owner);
+    } /* if(!b->owner->committing) */
+  } /* for ... */
+  pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+  fclose(w.out);
+  sql_xfree(w.buffer);
+  #ifdef SQL_ZLIB
+  if(w.has_zs) {
+    deflateEnd(&w.zs);
+  } /* if(w.has_zs) */
+  #endif /* SQL_ZLIB */
+  return NULL;
+}
+
+/* Übergibt den aktuellen Stapel an den Pool und holt einen leeren. */
+static void sql_pipeline_submit(struct sql_pipeline *p)
+{
+  struct sql_pipeline_batch *b = p->current;
+
+  pthread_mutex_lock(&sql_pipeline_pool.lock);
+  while(p->next_seq - p->commit_seq >= sql_pipeline_pool.window) {
+    /* Warten, bis der älteste Stapel geschrieben ist */
+    pthread_cond_wait(&sql_pipeline_pool.has_done, &sql_pipeline_pool.lock);
+  } /* while ... */
+
+  b->seq = p->next_seq++;
+  b->done = 0;
+  b->owner = p;
+  b->next = NULL;
+  p->window[b->seq % sql_pipeline_pool.window] = b;
+  if(NULL == sql_pipeline_pool.last_job) {
+    sql_pipeline_pool.first_job = b;
+  } else {
+    sql_pipeline_pool.last_job->next = b;
+  } /* if(NULL == ... last_job) */
+  sql_pipeline_pool.last_job = b;
+  pthread_cond_signal(&sql_pipeline_pool.has_job);
+
+  if(NULL != (p->current = p->free_batches)) {
+    p->free_batches = p->current->next;
+  } /* if(NULL != ... ) */
+  pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+  if(NULL == p->current) {
+    p->current = sql_pipeline_batch_new();
+  } /* if(NULL == p->current) */
+  p->current->used = 0;
+  p->current->flush = 0;
+}
+
+void sql_pipeline_init(size_t threads)
+{
+  sql_assert(0 < threads);
+  sql_assert(NULL == sql_pipeline_pool.threads);
+
+  sql_pipeline_pool.shutdown = 0;
+  sql_pipeline_pool.num_threads = threads;
+  /* Genug Stapel, damit alle Threads an einer Tabelle arbeiten können */
+  sql_pipeline_pool.window = 2 * threads + 2;
+  sql_pipeline_pool.threads = (pthread_t*)sql_xmalloc(threads * sizeof(pthread_t));
+
+  size_t i = 0;
+  for(; i < threads; i += 1) {
+    if(0 != pthread_create(sql_pipeline_pool.threads + i, NULL, sql_pipeline_thread, NULL)) {
+      /* Programmabbruch, da der Thread nicht gestartet werden konnte! */
+      sql_die("Could not start pipeline thread!");
+    } /* if(0 != pthread_create ... ) */
+  } /* for ... */
+  sql_debug("Started %zu pipeline threads.", threads);
+}
+
+void sql_pipeline_shutdown(void)
+{
+  if(NULL == sql_pipeline_pool.threads) {
+    /* Der Pool wurde nicht gestartet */
+    return;
+  } /* if(NULL == ... threads) */
+
+  pthread_mutex_lock(&sql_pipeline_pool.lock);
+  sql_pipeline_pool.shutdown = 1;
+  pthread_cond_broadcast(&sql_pipeline_pool.has_job);
+  pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+  size_t i = 0;
+  for(; i < sql_pipeline_pool.num_threads; i += 1) {
+    pthread_join(sql_pipeline_pool.threads[i], NULL);
+  } /* for ... */
+  sql_xfree(sql_pipeline_pool.threads);
+  sql_pipeline_pool.threads = NULL;
+  sql_pipeline_pool.num_threads = 0;
+}
+
+int sql_pipeline_enabled(void)
+{
+  return NULL != sql_pipeline_pool.threads;
+}
+
+void sql_pipeline_write_row(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(p->out);
+  sql_assert(sql_pipeline_enabled());
+
+  if(NULL == p->pipeline) {
+    /* Die Pipeline entsteht mit der ersten Zeile */
+    struct sql_pipeline *q = (struct sql_pipeline*)sql_xmalloc(sizeof(struct sql_pipeline));
+    q->table = p;
+    q->current = sql_pipeline_batch_new();
+    q->free_batches = NULL;
+    q->window = (struct sql_pipeline_batch**)sql_xmalloc(sql_pipeline_pool.window * sizeof(struct sql_pipeline_batch*));
+    memset(q->window, 0, sql_pipeline_pool.window * sizeof(struct sql_pipeline_batch*));
+    q->next_seq = 0;
+    q->commit_seq = 0;
+    q->committing = 0;
+    q->epoch = atomic_load_explicit(&sql_pipeline_epoch, memory_order_relaxed);
+    p->pipeline = q;
+  } /* if(NULL == p->pipeline) */
+
+  struct sql_pipeline_batch *b = p->pipeline->current;
+  struct sql_column *it = p->first_column;
+
+  for(; NULL != it; it = it->next) {
+    const char is_null = it->value.is_null ? 1 : 0;
+    sql_pipeline_batch_append(b, &is_null, 1);
+    if(is_null) {
+      continue;
+    } /* if(is_null) */
+
+    switch(it->type) {
+      case sql_column_type_int:
+        sql_pipeline_batch_append(b, &it->value.int_value, sizeof(it->value.int_value));
+        break;
+      case sql_column_type_float:
+        sql_pipeline_batch_append(b, &it->value.flt_value, sizeof(it->value.flt_value));
+        break;
+      default:
+        sql_pipeline_batch_append(b, &it->value.str_size, sizeof(it->value.str_size));
+        sql_pipeline_batch_append(b, it->value.str_value, it->value.str_size);
+        break;
+    } /* switch(it->type) */
+  } /* for ... */
+
+  if(SQL_PIPELINE_BATCH_SIZE <= b->used) {
+    /* Der Stapel ist voll */
+    sql_pipeline_submit(p->pipeline);
+  } else if(p->pipeline->epoch != atomic_load_explicit(&sql_pipeline_epoch, memory_order_relaxed)) {
+    /* Der Flusher war seit dem letzten Stapel aktiv */
+    sql_pipeline_flush(p);
+  } /* if ... */
+}
+
+void sql_pipeline_flush(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  struct sql_pipeline *q = p->pipeline;
+  if(NULL == q) {
+    /* Nix weiter */
+    return;
+  } /* if(NULL == q) */
+
+  q->epoch = atomic_load_explicit(&sql_pipeline_epoch, memory_order_relaxed);
+  if(0 < q->current->used) {
+    /* Angefangenen Stapel abgeben und nach dem Schreiben leeren */
+    q->current->flush = 1;
+    sql_pipeline_submit(q);
+  } /* if(0 < q->current->used) */
+}
+
+void sql_pipeline_request_flush(void)
+{
+  atomic_fetch_add_explicit(&sql_pipeline_epoch, 1, memory_order_relaxed);
+}
+
+void sql_pipeline_close(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  struct sql_pipeline *q = p->pipeline;
+  if(NULL == q) {
+    /* Die Tabelle hat keine Zeilen über die Pipeline geschrieben */
+    return;
+  } /* if(NULL == q) */
+
+  if(0 < q->current->used) {
+    /* Angefangenen Stapel abgeben */
+    sql_pipeline_submit(q);
+  } /* if(0 < q->current->used) */
+
+  /* Warten, bis alle Stapel geschrieben sind und kein Thread mehr die
+   * Pipeline benutzt; beides ändert sich nur unter der Sperre.
+   */
+  pthread_mutex_lock(&sql_pipeline_pool.lock);
+  while((q->commit_seq != q->next_seq) || q->committing) {
+    pthread_cond_wait(&sql_pipeline_pool.has_done, &sql_pipeline_pool.lock);
+  } /* while ... */
+  pthread_mutex_unlock(&sql_pipeline_pool.lock);
+
+  while(NULL != q->free_batches) {
+    struct sql_pipeline_batch *b = q->free_batches;
+    q->free_batches = b->next;
+    sql_pipeline_batch_free(b);
+  } /* while ... */
+  sql_pipeline_batch_free(q->current);
+  sql_xfree(q->window);
+  sql_xfree(q);
+  p->pipeline = NULL;
+}
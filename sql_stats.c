@@ -0,0 +1,407 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <math.h>
+#include <stdint.h>
+
+/* Spaltenstatistik:
+ * Minimum, Maximum und die Anzahl der Werte und NULLs werden beim Setzen der
+ * Werte mitgeführt. Die Anzahl verschiedener Werte wird mit HyperLogLog
+ * geschätzt (2^12 Register, Standardfehler etwa 1,6%).
+ */
+
+#define SQL_STATS_BITS       12
+#define SQL_STATS_REGISTERS  (1 << SQL_STATS_BITS)
+
+struct sql_stats {
+  enum sql_column_type type;
+  int         is_unsigned;
+  size_t      values;
+  size_t      nulls;
+  int         has_range;
+  long long   min_int;
+  long long   max_int;
+  long double min_flt;
+  long double max_flt;
+  char       *min_str;
+  size_t      min_size;
+  size_t      min_capacity;
+  char       *max_str;
+  size_t      max_size;
+  size_t      max_capacity;
+  unsigned char registers[SQL_STATS_REGISTERS];
+}; /* struct sql_stats */
+
+/* Verteilt die Bits eines Schlüssels gleichmäßig (splitmix64) */
+static uint64_t sql_stats_mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static void sql_stats_add_hash(struct sql_stats *p, uint64_t h)
+{
+  const size_t i = (size_t)(h >> (64 - SQL_STATS_BITS));
+  /* Das Schutzbit begrenzt den Rang, wenn alle restlichen Bits 0 sind */
+  const uint64_t w = (h << SQL_STATS_BITS) | (1ULL << (SQL_STATS_BITS - 1));
+  const unsigned char rank = (unsigned char)(__builtin_clzll(w) + 1);
+
+  if(p->registers[i] < rank) {
+    p->registers[i] = rank;
+  } /* if ... */
+}
+
+static void sql_stats_copy(char **dst, size_t *size, size_t *capacity, const char *x, size_t n)
+{
+  if(*capacity < n + 1) {
+    /* Der Puffer wächst nur */
+    *capacity = 2 * n + 16;
+    *dst = (char*)sql_xrealloc(*dst, *capacity);
+  } /* if ... */
+
+  memcpy(*dst, x, n);
+  (*dst)[n] = 0;
+  *size = n;
+}
+
+static int sql_stats_compare(const char *x, size_t n, const char *y, size_t m)
+{
+  const int c = memcmp(x, y, (n < m) ? n : m);
+  if(0 != c) {
+    return c;
+  } /* if(0 != c) */
+
+  return (n > m) - (n < m);
+}
+
+struct sql_stats *sql_stats_new(enum sql_column_type type, int is_unsigned)
+{
+  struct sql_stats *p = (struct sql_stats*)sql_xmalloc(sizeof(struct sql_stats));
+  memset(p, 0, sizeof(struct sql_stats));
+  p->type = type;
+  p->is_unsigned = is_unsigned;
+  p->min_str = NULL;
+  p->max_str = NULL;
+  return p;
+}
+
+void sql_stats_free(struct sql_stats *p)
+{
+  if(NULL != p) {
+    sql_xfree(p->min_str);
+    sql_xfree(p->max_str);
+    sql_xfree(p);
+  } /* if(NULL != p) */
+}
+
+void sql_stats_add_null(struct sql_stats *p)
+{
+  sql_check_nullptr(p);
+  p->nulls += 1;
+}
+
+void sql_stats_add_int(struct sql_stats *p, long long x)
+{
+  sql_check_nullptr(p);
+
+  if(p->is_unsigned) {
+    /* Der Wert ist das Bitmuster einer vorzeichenlosen Zahl */
+    if(!p->has_range || ((unsigned long long)x < (unsigned long long)p->min_int)) {
+      p->min_int = x;
+    } /* if ... */
+    if(!p->has_range || ((unsigned long long)x > (unsigned long long)p->max_int)) {
+      p->max_int = x;
+    } /* if ... */
+  } else {
+    if(!p->has_range || (x < p->min_int)) {
+      p->min_int = x;
+    } /* if ... */
+    if(!p->has_range || (x > p->max_int)) {
+      p->max_int = x;
+    } /* if ... */
+  } /* if(p->is_unsigned) */
+  p->has_range = 1;
+  p->values += 1;
+
+  sql_stats_add_hash(p, sql_stats_mix((uint64_t)x));
+}
+
+void sql_stats_add_float(struct sql_stats *p, long double x)
+{
+  sql_check_nullptr(p);
+
+  if(!p->has_range || (x < p->min_flt)) {
+    p->min_flt = x;
+  } /* if ... */
+  if(!p->has_range || (x > p->max_flt)) {
+    p->max_flt = x;
+  } /* if ... */
+  p->has_range = 1;
+  p->values += 1;
+
+  /* Ein long double enthält Füllbytes, deshalb wird der double gehasht */
+  double d = (0.0 == x) ? 0.0 : (double)x;
+  uint64_t bits = 0;
+  memcpy(&bits, &d, sizeof(bits));
+  sql_stats_add_hash(p, sql_stats_mix(bits));
+}
+
+void sql_stats_add_text(struct sql_stats *p, const char *x, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(x);
+
+  p->values += 1;
+
+  /* FNV-1a */
+  uint64_t h = 0xcbf29ce484222325ULL;
+  size_t i = 0;
+  for(; i < n; i += 1) {
+    h ^= (unsigned char)x[i];
+    h *= 0x100000001b3ULL;
+  } /* for ... */
+  sql_stats_add_hash(p, sql_stats_mix(h));
+
+  if(sql_column_type_blob == p->type) {
+    /* Binärdaten haben keine sinnvolle Ordnung */
+    return;
+  } /* if(sql_column_type_blob == p->type) */
+
+  if(sql_column_type_decimal == p->type) {
+    /* Dezimalzahlen werden nach ihrem Wert verglichen */
+    const long double v = strtold(x, NULL);
+    if(!p->has_range || (v < p->min_flt)) {
+      p->min_flt = v;
+      sql_stats_copy(&p->min_str, &p->min_size, &p->min_capacity, x, n);
+    } /* if ... */
+    if(!p->has_range || (v > p->max_flt)) {
+      p->max_flt = v;
+      sql_stats_copy(&p->max_str, &p->max_size, &p->max_capacity, x, n);
+    } /* if ... */
+  } else {
+    /* Datum und Uhrzeit sind so auch zeitlich geordnet */
+    if(!p->has_range || (0 > sql_stats_compare(x, n, p->min_str, p->min_size))) {
+      sql_stats_copy(&p->min_str, &p->min_size, &p->min_capacity, x, n);
+    } /* if ... */
+    if(!p->has_range || (0 < sql_stats_compare(x, n, p->max_str, p->max_size))) {
+      sql_stats_copy(&p->max_str, &p->max_size, &p->max_capacity, x, n);
+    } /* if ... */
+  } /* if(sql_column_type_decimal == p->type) */
+  p->has_range = 1;
+}
+
+void sql_stats_add_value(struct sql_stats *p, const struct sql_value *v)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(v);
+
+  if(v->is_null) {
+    sql_stats_add_null(p);
+    return;
+  } /* if(v->is_null) */
+
+  switch(p->type) {
+    case sql_column_type_int:
+      sql_stats_add_int(p, v->int_value);
+      break;
+    case sql_column_type_float:
+      sql_stats_add_float(p, v->flt_value);
+      break;
+    default:
+      sql_stats_add_text(p, v->str_value, v->str_size);
+  }; /* switch(p->type) */
+}
+
+size_t sql_stats_get_distinct(const struct sql_stats *p)
+{
+  sql_check_nullptr(p);
+
+  const double m = SQL_STATS_REGISTERS;
+  double sum = 0.0;
+  size_t zeros = 0;
+  size_t i = 0;
+  for(; i < SQL_STATS_REGISTERS; i += 1) {
+    sum += ldexp(1.0, -(int)p->registers[i]);
+    zeros += (0 == p->registers[i]);
+  } /* for ... */
+
+  double e = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+  if((e <= 2.5 * m) && (0 < zeros)) {
+    /* Wenige Werte: Lineares Zählen ist genauer */
+    e = m * log(m / (double)zeros);
+  } /* if ... */
+
+  return (size_t)(e + 0.5);
+}
+
+/* Länge der gültigen UTF-8-Sequenz ab X, 0 wenn ungültig */
+static size_t sql_stats_utf8_length(const unsigned char *x, size_t n)
+{
+  size_t l = 0;
+  unsigned char lo = 0x80;
+  unsigned char hi = 0xbf;
+
+  if(0xc2 <= x[0] && 0xdf >= x[0]) {
+    l = 2;
+  } else if(0xe0 <= x[0] && 0xef >= x[0]) {
+    l = 3;
+    lo = (0xe0 == x[0]) ? 0xa0 : 0x80;
+    hi = (0xed == x[0]) ? 0x9f : 0xbf;
+  } else if(0xf0 <= x[0] && 0xf4 >= x[0]) {
+    l = 4;
+    lo = (0xf0 == x[0]) ? 0x90 : 0x80;
+    hi = (0xf4 == x[0]) ? 0x8f : 0xbf;
+  } else {
+    /* Kein Startbyte */
+    return 0;
+  } /* if ... */
+
+  if((n < l) || (lo > x[1]) || (hi < x[1])) {
+    return 0;
+  } /* if ... */
+
+  size_t i = 2;
+  for(; i < l; i += 1) {
+    if(0x80 != (x[i] & 0xc0)) {
+      return 0;
+    } /* if ... */
+  } /* for ... */
+  return l;
+}
+
+static void sql_stats_write_string(FILE *out, const char *x, size_t n)
+{
+  const unsigned char *it = (const unsigned char*)x;
+  const unsigned char *end = it + n;
+
+  fputc('"', out);
+  while(it != end) {
+    const unsigned char c = *it;
+    if(('"' == c) || ('\\' == c)) {
+      fputc('\\', out);
+      fputc(c, out);
+    } else if(0x20 > c) {
+      fprintf(out, "\\u%04x", c);
+    } else if(0x80 > c) {
+      fputc(c, out);
+    } else {
+      const size_t l = sql_stats_utf8_length(it, end - it);
+      if(0 == l) {
+        /* Kein UTF-8 (z.B. latin1 oder Binärdaten): Byte als Zeichen ausgeben */
+        fprintf(out, "\\u%04x", c);
+      } else {
+        fwrite(it, 1, l, out);
+        it += l;
+        continue;
+      } /* if(0 == l) */
+    } /* if ... */
+    it += 1;
+  } /* while ... */
+  fputc('"', out);
+}
+
+static void sql_stats_write_float(FILE *out, long double x)
+{
+  if(isfinite(x)) {
+    fprintf(out, "%.17Lg", x);
+  } else {
+    /* JSON kennt weder Unendlich noch NaN */
+    fprintf(out, "null");
+  } /* if(isfinite(x)) */
+}
+
+static void sql_stats_write_range(FILE *out, const struct sql_stats *p, int is_max)
+{
+  if(!p->has_range || (sql_column_type_blob == p->type)) {
+    fprintf(out, "null");
+    return;
+  } /* if ... */
+
+  switch(p->type) {
+    case sql_column_type_int:
+      fprintf(out, p->is_unsigned ? "%llu" : "%lli", is_max ? p->max_int : p->min_int);
+      break;
+    case sql_column_type_float:
+      sql_stats_write_float(out, is_max ? p->max_flt : p->min_flt);
+      break;
+    default:
+      if(is_max) {
+        sql_stats_write_string(out, p->max_str, p->max_size);
+      } else {
+        sql_stats_write_string(out, p->min_str, p->min_size);
+      } /* if(is_max) */
+  }; /* switch(p->type) */
+}
+
+void sql_stats_write(const struct sql_table *p, const char *filename)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(filename);
+
+  FILE *out = NULL;
+  if(NULL == (out = fopen(filename, "w"))) {
+    /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+    sql_die("Could not open file `%s'! (Error: %m)", filename);
+  } /* if(NULL == ... fopen ... ) */
+
+  fprintf(out, "{\n  \"table\": ");
+  sql_stats_write_string(out, p->name, strlen(p->name));
+  fprintf(out, ",\n  \"file\": ");
+  if(p->is_descriptor) {
+    /* Die Tabelle ging an einen Deskriptor, es gibt keine Datei */
+    fprintf(out, "null");
+  } else {
+    sql_stats_write_string(out, p->filename, strlen(p->filename));
+  } /* if(p->is_descriptor) */
+  fprintf(out, ",\n  \"rows\": %zu,\n  \"columns\": [", p->rows);
+
+  const struct sql_column *it = p->first_column;
+  for(; NULL != it; it = it->next) {
+    if(NULL == it->stats) {
+      /* Spalte ohne Statistik */
+      continue;
+    } /* if(NULL == it->stats) */
+
+    fprintf(out, "%s\n    {\"name\": ", (it == p->first_column) ? "" : ",");
+    sql_stats_write_string(out, it->name, strlen(it->name));
+    fprintf(out, ", \"type\": \"%s\"", sql_column_get_type_name(it->type));
+    fprintf(out, ", \"values\": %zu, \"nulls\": %zu", it->stats->values, it->stats->nulls);
+    fprintf(out, ", \"distinct\": %zu", (0 < it->stats->values) ? sql_stats_get_distinct(it->stats) : 0);
+    fprintf(out, ", \"min\": ");
+    sql_stats_write_range(out, it->stats, 0);
+    fprintf(out, ", \"max\": ");
+    sql_stats_write_range(out, it->stats, 1);
+    fprintf(out, "}");
+  } /* for ... */
+
+  fprintf(out, "\n  ]\n}\n");
+  if(0 != fclose(out)) {
+    /* Programmabbruch, da Daten verloren gegangen sind! */
+    sql_die("Could not write file `%s'! (Error: %m)", filename);
+  } /* if(0 != fclose(out)) */
+}
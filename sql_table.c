@@ -22,12 +22,26 @@
  */
 
 #include "sql.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <unistd.h>
 #ifdef SQL_ZLIB
 #include <zlib.h>
 #endif /* SQL_ZLIB */
 
+#ifdef SQL_ZLIB
+/* Beim Streaming wird jeder volle stdio-Puffer sofort lesbar gemacht */
+static ssize_t sql_table_gzwrite_sync(void *cookie, const char *buf, size_t size)
+{
+  const int l = gzwrite((gzFile)cookie, buf, size);
+  if((0 >= l) || (Z_OK != gzflush((gzFile)cookie, Z_SYNC_FLUSH))) {
+    return -1;
+  } /* if ... */
+  return l;
+}
+#endif /* SQL_ZLIB */
+
 struct sql_table *sql_table_new(void)
 {
   struct sql_table *tab = (struct sql_table*)sql_xmalloc(sizeof(struct sql_table));
@@ -40,15 +54,63 @@ struct sql_table *sql_table_new(void)
   tab->next = NULL;
   tab->rows = 0;
   tab->drop_data = 0;
+  tab->is_descriptor = 0;
+  tab->float_fmt = NULL;
+  tab->null_token = NULL;
+  tab->pipeline = NULL;
+  tab->writer = NULL;
+  tab->zfile = NULL;
+  tab->zfile_flushed = 0;
+  tab->zfile_finished = 0;
+  tab->zfile_fd = -1;
+  tab->unflushed_rows = 0;
+  tab->stats_file = NULL;
+  tab->schema.begin = 0;
+  tab->schema.end = 0;
+  tab->schema.rows = 0;
+  tab->ranges = NULL;
+  tab->num_ranges = 0;
+  tab->hash = 0;
+  tab->skipped_statements = 0;
+  tab->skipped_rows = 0;
+  tab->samples = NULL;
+  tab->num_samples = 0;
+  tab->sample_seen = 0;
+  tab->sample_slot = 0;
+  tab->sample_out = NULL;
+  tab->sample_buffer = NULL;
+  tab->sample_size = 0;
   return tab;
 }
 
+static void sql_table_free_samples(struct sql_table *p)
+{
+  size_t i = 0;
+  for(; i < p->num_samples; i += 1) {
+    sql_xfree(p->samples[i].data);
+    sql_xfree(p->samples[i].values);
+  } /* for ... */
+
+  sql_xfree(p->samples);
+  p->samples = NULL;
+  p->num_samples = 0;
+
+  if(NULL != p->sample_out) {
+    fclose(p->sample_out);
+    sql_xfree(p->sample_buffer);
+    p->sample_out = NULL;
+    p->sample_buffer = NULL;
+    p->sample_size = 0;
+  } /* if(NULL != p->sample_out) */
+}
+
 void sql_table_free(struct sql_table *p)
 {
   if(NULL != p) {
     sql_table_close(p);
     sql_table_set_name(p, NULL);
     sql_table_set_file(p, NULL);
+    sql_xfree(p->stats_file);
     sql_table_del_sibbling(p);
 
     /* Spalten löschen */
@@ -59,6 +121,8 @@ void sql_table_free(struct sql_table *p)
       it = it_next;
     } /* while ... */
 
+    sql_table_free_samples(p);
+    sql_xfree(p->ranges);
     sql_xfree(p);
   } /* if(NULL != p) */
 }
@@ -89,6 +153,37 @@ void sql_table_set_file(struct sql_table *p, const char *name)
   p->filename = sql_xstrdup(name);
 }
 
+void sql_table_get_filename(const struct sql_table *p, const struct sql_context *q, char *buf, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(q);
+  sql_check_nullptr(buf);
+
+  if(NULL == q->out_dir) {
+    snprintf(buf, n, "%s.%s.csv%s", q->source_file, p->name, q->compress ? ".gz" : "");
+  } else {
+    snprintf(buf, n, "%s/%s.%s.csv%s", q->out_dir, q->source_file, p->name, q->compress ? ".gz" : "");
+  } /* if(NULL == q->out_dir) */
+}
+
+void sql_table_get_stats_filename(const struct sql_table *p, const struct sql_context *q, char *buf, size_t n)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(q);
+  sql_check_nullptr(buf);
+
+  /* Statistik neben die Ausgabe, bei Deskriptoren ins Ausgabeverzeichnis */
+  if(NULL == sql_context_get_output(q, p->name)) {
+    char filename[2 * PATH_MAX] = {0};
+    sql_table_get_filename(p, q, filename, sizeof(filename));
+    snprintf(buf, n, "%s.stats.json", filename);
+  } else if(NULL == q->out_dir) {
+    snprintf(buf, n, "%s.%s.stats.json", q->source_file, p->name);
+  } else {
+    snprintf(buf, n, "%s/%s.%s.stats.json", q->out_dir, q->source_file, p->name);
+  } /* if ... */
+}
+
 void sql_table_open(struct sql_table *p, const struct sql_context *q)
 {
   sql_check_nullptr(p);
@@ -101,32 +196,56 @@ void sql_table_open(struct sql_table *p, const struct sql_context *q)
   } /* if(NULL != p->out) */
 
   char tmp_filename[2 * PATH_MAX] = {0};
-  if(NULL == q->out_dir) {
-    snprintf(tmp_filename, sizeof(tmp_filename), "%s.%s.csv%s", q->source_file, p->name, q->compress ? ".gz" : "");
-  } else {
-    snprintf(tmp_filename, sizeof(tmp_filename), "%s/%s.%s.csv%s", q->out_dir, q->source_file, p->name, q->compress ? ".gz" : "");
-  } /* if(NULL == q->out_dir) */
+  sql_table_get_filename(p, q, tmp_filename, sizeof(tmp_filename));
   sql_table_set_file(p, tmp_filename);
   sql_debug("Opening table `%s' as file `%s'...", p->name, p->filename);
 
   /* Der Header soll erzeugt werden, wenn:
    * 1. Die Tabelle noch nicht existiert
    * 2. oder verworfen werden soll.
+   * Auf einen Deskriptor (-F) nur beim ersten Öffnen.
    */
-  const int allow_header = !(0 == access(p->filename, W_OK)) || !q->dont_drop;
+  struct sql_output *output = sql_context_get_output(q, p->name);
+  const int fd = (NULL != output) ? output->fd : -1;
+  const int allow_header = (NULL != output) ? !output->has_header : (!(0 == access(p->filename, W_OK)) || !q->dont_drop);
   const char *mode = q->dont_drop ? "a" : "w";
+  int out_fd = -1;
+  if(0 <= fd) {
+    /* Der Deskriptor bleibt für weitere Eingabedateien offen */
+    sql_debug("Writing table `%s' to descriptor %i...", p->name, fd);
+    if(0 > (out_fd = dup(fd))) {
+      sql_die("Could not use descriptor %i for table `%s'! (Error: %m)", fd, p->name);
+    } /* if(0 > ... dup ... ) */
+  } /* if(0 <= fd) */
   p->float_fmt = q->float_fmt;
+  p->null_token = q->null_token;
+  p->is_descriptor = (0 <= fd);
+
+  if((NULL != p->first_column) && (NULL != p->first_column->stats) && (NULL == p->stats_file)) {
+    char stats_filename[2 * PATH_MAX + 16] = {0};
+    sql_table_get_stats_filename(p, q, stats_filename, sizeof(stats_filename));
+    p->stats_file = sql_xstrdup(stats_filename);
+  } /* if ... stats ... */
 
   if(q->compress) {
     #ifdef SQL_ZLIB
+    /* Den Deskriptor behalten, damit die Pipeline fertige gzip-Blöcke
+     * direkt anhängen kann.
+     */
+    if((0 > out_fd) && (0 > (out_fd = open(p->filename, O_WRONLY | O_CREAT | (q->dont_drop ? O_APPEND : O_TRUNC), 0666)))) {
+      /* Die Datei kann nicht geöffnet werden. */
+      sql_die("Could not open compressed file `%s'! (Error: %m)", p->filename);
+    } /* if ... open ... */
+
     gzFile zf = Z_NULL;
-    if(NULL == (zf = gzopen(p->filename, mode))) {
+    if(NULL == (zf = gzdopen(out_fd, mode))) {
       /* Die Datei kann nicht geöffnet werden. */
+      close(out_fd);
       sql_die("Could not open compressed file `%s'!", p->filename);
-    } /* if(NULL == ... gzopen(...)) */
+    } /* if(NULL == ... gzdopen(...)) */
     const cookie_io_functions_t cfunc = {
       (cookie_read_function_t*)gzread,
-      (cookie_write_function_t*)gzwrite,
+      (0 < q->flush_bytes) ? sql_table_gzwrite_sync : (cookie_write_function_t*)gzwrite,
       (cookie_seek_function_t*)gzseek,
       (cookie_close_function_t*)gzclose};
     if(NULL == (p->out = fopencookie(zf, mode, cfunc))) {
@@ -134,9 +253,23 @@ void sql_table_open(struct sql_table *p, const struct sql_context *q)
       gzclose(zf);
       sql_die("Could not open compressed file `%s'!", p->filename);
     } /* if(NULL == ...fopencookie(...)) */
+    p->zfile = zf;
+    p->zfile_flushed = 0;
+    p->zfile_finished = 0;
+    p->zfile_fd = out_fd;
     #else /* SQL_ZLIB */
     sql_die("Program was compiled without compression!");
     #endif /* SQL_ZLIB */
+  } else if(0 <= out_fd) {
+    if(NULL == (p->out = fdopen(out_fd, mode))) {
+      /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+      sql_die("Could not open descriptor %i! (Error: %m)", fd);
+    } /* if(NULL == ... fdopen ... ) */
+  } else if(sql_writer_enabled()) {
+    if(NULL == (p->out = sql_writer_open(p->filename, mode, &p->writer))) {
+      /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
+      sql_die("Could not open file `%s'! (Error: %m)", p->filename);
+    } /* if(NULL == ... sql_writer_open ... ) */
   } else {
     if(NULL == (p->out = fopen(p->filename, mode))) {
       /* Programmabbruch, da die Datei nicht geöffnet werden konnte! */
@@ -145,7 +278,13 @@ void sql_table_open(struct sql_table *p, const struct sql_context *q)
   } /* if(p->compress) */
 
   sql_check_nullptr(p->out);
-  p->rows = 0;
+  p->unflushed_rows = 0;
+
+  if(0 < q->flush_bytes) {
+    /* Der Puffer wird geleert, sobald er N Bytes enthält */
+    setvbuf(p->out, NULL, _IOFBF, q->flush_bytes);
+  } /* if(0 < q->flush_bytes) */
+  sql_flusher_add(p);
 
   if(q->add_header && allow_header) {
     /* Header hinzufügen */
@@ -156,6 +295,11 @@ void sql_table_open(struct sql_table *p, const struct sql_context *q)
     /* Typen hinzufügen */
     sql_table_write_types(p);
   } /* if(q->add_types) */
+
+  if(NULL != output) {
+    /* Weitere Eingabedateien setzen die Ausgabe fort */
+    output->has_header = 1;
+  } /* if(NULL != output) */
 }
 
 void sql_table_write_header(struct sql_table *p)
@@ -194,56 +338,291 @@ void sql_table_write_types(struct sql_table *p)
     } /* if(is_first_column) */
     is_first_column = 0;
 
-    fprintf(p->out, "%s:", it->name);
-    switch(it->type) {
-      case sql_column_type_none:
-        fprintf(p->out, "none");
-        break;
-      case sql_column_type_int:
-        fprintf(p->out, "int");
-        break;
-      case sql_column_type_float:
-        fprintf(p->out, "float");
-        break;
-      case sql_column_type_str:
-        fprintf(p->out, "string");
-        break;
-      default:
-        /* Programmabbruch, da der Typ unbekannt ist! */
-        sql_die_invalid_type(it);
-    } /* switch(p->type) */
+    fprintf(p->out, "%s:%s", it->name, sql_column_get_type_name(it->type));
   } /* for ... */
 
   fprintf(p->out, "\n");
 }
-void sql_table_write_row(struct sql_table *p)
-{
-  sql_check_nullptr(p);
-  sql_check_nullptr(p->out);
 
+static void sql_table_write_values(struct sql_table *p, FILE *out)
+{
   int is_first_column = 1;
   struct sql_column *it = p->first_column;
 
+  /* Die Zeile wird am Stück geschrieben */
+  flockfile(out);
   for(; NULL != it; it = it->next) {
     if(!is_first_column) {
-      fprintf(p->out, ",");
+      fputc_unlocked(',', out);
     } /* if(!is_first_column) */
     is_first_column = 0;
 
+    if(it->value.is_null) {
+      fputs_unlocked(p->null_token, out);
+    } else {
+      it->write(out, &it->value, p);
+    } /* if(it->value.is_null) */
+  } /* for ... */
+
+  fputc_unlocked('\n', out);
+  funlockfile(out);
+}
+
+void sql_table_write_row(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(p->out);
+
+  sql_table_write_values(p, p->out);
+}
+
+/* Legt die Werte der Zeile im Platz der Stichprobe ab:
+ * Je Spalte ein Byte für NULL, dann der Wert bzw. Länge und Text.
+ */
+static void sql_table_save_values(struct sql_table *p, struct sql_sample *s)
+{
+  size_t n = 0;
+  const struct sql_column *it = p->first_column;
+  for(; NULL != it; it = it->next) {
+    n += 1;
+    if(it->value.is_null) {
+      continue;
+    } /* if(it->value.is_null) */
+
+    switch(it->type) {
+      case sql_column_type_int:   n += sizeof(it->value.int_value); break;
+      case sql_column_type_float: n += sizeof(it->value.flt_value); break;
+      default:                    n += sizeof(size_t) + it->value.str_size;
+    }; /* switch(it->type) */
+  } /* for ... */
+
+  s->values = (char*)sql_xrealloc(s->values, n);
+  s->values_size = n;
+
+  char *out = s->values;
+  for(it = p->first_column; NULL != it; it = it->next) {
+    *out++ = it->value.is_null ? 1 : 0;
+    if(it->value.is_null) {
+      continue;
+    } /* if(it->value.is_null) */
+
     switch(it->type) {
       case sql_column_type_int:
-        fprintf(p->out, "%lli", it->int_value);
+        memcpy(out, &it->value.int_value, sizeof(it->value.int_value));
+        out += sizeof(it->value.int_value);
         break;
       case sql_column_type_float:
-        fprintf(p->out, p->float_fmt, it->flt_value);
+        memcpy(out, &it->value.flt_value, sizeof(it->value.flt_value));
+        out += sizeof(it->value.flt_value);
         break;
       default:
-        /* Programmabbruch, da der Typ unbekannt ist! */
-        sql_die_invalid_type(it);
-    } /* switch(p->type) */
+        memcpy(out, &it->value.str_size, sizeof(size_t));
+        out += sizeof(size_t);
+        memcpy(out, it->value.str_value, it->value.str_size);
+        out += it->value.str_size;
+    }; /* switch(it->type) */
   } /* for ... */
+}
 
-  fprintf(p->out, "\n");
+static void sql_table_add_sample_stats(struct sql_table *p, const struct sql_sample *s)
+{
+  const char *it = s->values;
+  struct sql_column *col = p->first_column;
+
+  for(; NULL != col; col = col->next) {
+    struct sql_value v;
+    memset(&v, 0, sizeof(v));
+    v.is_null = *it++;
+    if(!v.is_null) {
+      switch(col->type) {
+        case sql_column_type_int:
+          memcpy(&v.int_value, it, sizeof(v.int_value));
+          it += sizeof(v.int_value);
+          break;
+        case sql_column_type_float:
+          memcpy(&v.flt_value, it, sizeof(v.flt_value));
+          it += sizeof(v.flt_value);
+          break;
+        default:
+          memcpy(&v.str_size, it, sizeof(size_t));
+          it += sizeof(size_t);
+          v.str_value = (char*)it;
+          it += v.str_size;
+      }; /* switch(col->type) */
+    } /* if(!v.is_null) */
+    sql_stats_add_value(col->stats, &v);
+  } /* for ... */
+}
+
+void sql_table_add_stats(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  struct sql_column *it = p->first_column;
+  for(; NULL != it; it = it->next) {
+    if(NULL != it->stats) {
+      sql_stats_add_value(it->stats, &it->value);
+    } /* if(NULL != it->stats) */
+  } /* for ... */
+}
+
+void sql_table_write_sample(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(p->samples);
+  sql_assert(p->sample_slot < p->num_samples);
+
+  if(NULL == p->sample_out) {
+    if(NULL == (p->sample_out = open_memstream(&p->sample_buffer, &p->sample_size))) {
+      /* Programmabbruch, da kein Speicher vorhanden ist! */
+      sql_die("Could not open memory stream! (Error: %m)");
+    } /* if(NULL == ... open_memstream ... ) */
+  } /* if(NULL == p->sample_out) */
+
+  /* Zeile formatieren und im gewählten Platz ablegen */
+  rewind(p->sample_out);
+  sql_table_write_values(p, p->sample_out);
+  fflush(p->sample_out);
+
+  struct sql_sample *s = p->samples + p->sample_slot;
+  s->data = (char*)sql_xrealloc(s->data, p->sample_size);
+  memcpy(s->data, p->sample_buffer, p->sample_size);
+  s->size = p->sample_size;
+  s->row = p->rows;
+
+  if((NULL != p->first_column) && (NULL != p->first_column->stats)) {
+    /* Die Statistik zählt erst die endgültige Stichprobe */
+    sql_table_save_values(p, s);
+  } /* if ... stats ... */
+}
+
+static int sql_table_compare_samples(const void *a, const void *b)
+{
+  const struct sql_sample *x = (const struct sql_sample*)a;
+  const struct sql_sample *y = (const struct sql_sample*)b;
+  return (x->row > y->row) - (x->row < y->row);
+}
+
+/* Schreibt die Stichprobe in der Reihenfolge der Eingabe. */
+static void sql_table_write_samples(struct sql_table *p)
+{
+  if(NULL == p->samples) {
+    /* Keine Stichprobe */
+    return;
+  } /* if(NULL == p->samples) */
+
+  const size_t n = (p->sample_seen < p->num_samples) ? p->sample_seen : p->num_samples;
+  qsort(p->samples, n, sizeof(struct sql_sample), sql_table_compare_samples);
+
+  size_t i = 0;
+  for(; i < n; i += 1) {
+    if(NULL != p->samples[i].data) {
+      fwrite(p->samples[i].data, 1, p->samples[i].size, p->out);
+    } /* if(NULL != ... data) */
+    if(NULL != p->samples[i].values) {
+      sql_table_add_sample_stats(p, p->samples + i);
+    } /* if(NULL != ... values) */
+  } /* for ... */
+
+  sql_table_free_samples(p);
+}
+
+void sql_table_flush(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  if(NULL == p->out) {
+    /* Nix weiter */
+    return;
+  } /* if(NULL == p->out) */
+
+  flockfile(p->out);
+  if(0 != fflush_unlocked(p->out)) {
+    /* Programmabbruch, da Daten verloren gegangen sind! */
+    sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+  } /* if(0 != fflush_unlocked(p->out)) */
+
+  #ifdef SQL_ZLIB
+  if(NULL != p->zfile) {
+    /* Nur neue Daten erzeugen einen Sync-Block */
+    const long long pos = gztell((gzFile)p->zfile);
+    if(pos != p->zfile_flushed) {
+      gzflush((gzFile)p->zfile, Z_SYNC_FLUSH);
+      p->zfile_flushed = pos;
+    } /* if(pos != p->zfile_flushed) */
+  } /* if(NULL != p->zfile) */
+  #endif /* SQL_ZLIB */
+  funlockfile(p->out);
+}
+
+void sql_table_write_block(struct sql_table *p, const void *data, size_t size)
+{
+  sql_check_nullptr(p);
+  sql_check_nullptr(p->out);
+  sql_check_nullptr(data);
+
+  flockfile(p->out);
+  #ifdef SQL_ZLIB
+  if(NULL != p->zfile) {
+    /* DATA ist ein vollständiger gzip-Block. Davor muss der laufende Block
+     * (etwa der Header) abgeschlossen werden, sonst würde er zerteilt.
+     */
+    if(0 != fflush_unlocked(p->out)) {
+      /* Programmabbruch, da Daten verloren gegangen sind! */
+      sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+    } /* if(0 != fflush_unlocked(p->out)) */
+
+    const long long pos = gztell((gzFile)p->zfile);
+    if(pos != p->zfile_finished) {
+      if(Z_OK != gzflush((gzFile)p->zfile, Z_FINISH)) {
+        /* Programmabbruch, da Daten verloren gegangen sind! */
+        sql_die("Could not write file `%s'!", p->filename);
+      } /* if(Z_OK != gzflush ... ) */
+      p->zfile_finished = pos;
+      p->zfile_flushed = pos;
+    } /* if(pos != p->zfile_finished) */
+
+    const char *it = (const char*)data;
+    while(0 < size) {
+      const ssize_t n = write(p->zfile_fd, it, size);
+      if((0 > n) && (EINTR == errno)) {
+        continue;
+      } else if(0 >= n) {
+        /* Programmabbruch, da Daten verloren gegangen sind! */
+        sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+      } /* if ... */
+      it += n;
+      size -= (size_t)n;
+    } /* while(0 < size) */
+    funlockfile(p->out);
+    return;
+  } /* if(NULL != p->zfile) */
+  #endif /* SQL_ZLIB */
+
+  if(size != fwrite_unlocked(data, 1, size, p->out)) {
+    /* Programmabbruch, da Daten verloren gegangen sind! */
+    sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+  } /* if(size != fwrite_unlocked ... ) */
+  funlockfile(p->out);
+}
+
+void sql_table_release(struct sql_table *p)
+{
+  sql_check_nullptr(p);
+
+  if((NULL == p->out) || (NULL == p->writer)) {
+    /* Nix weiter */
+    return;
+  } /* if ... */
+
+  /* Der Flusher oder die Pipeline könnten gleichzeitig schreiben */
+  flockfile(p->out);
+  if(0 != fflush_unlocked(p->out)) {
+    /* Programmabbruch, da Daten verloren gegangen sind! */
+    sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+  } /* if(0 != fflush_unlocked(p->out)) */
+  sql_writer_release(p->writer);
+  funlockfile(p->out);
 }
 
 void sql_table_close(struct sql_table *p)
@@ -254,11 +633,55 @@ void sql_table_close(struct sql_table *p)
     /* Datei wurde bereits geschlossen */
     sql_debug("Table `%s' has already been closed!", p->name);
   } else {
-    fclose(p->out);
+    /* Ausstehende Zeilen der Stichprobe und der Pipeline zuerst schreiben */
+    sql_flusher_remove(p);
+    sql_table_write_samples(p);
+    sql_pipeline_close(p);
+    if(0 != fclose(p->out)) {
+      /* Programmabbruch, da Daten verloren gegangen sind! */
+      sql_die("Could not write file `%s'! (Error: %m)", p->filename);
+    } /* if(0 != fclose(p->out)) */
     p->out = NULL;
+    p->zfile = NULL;
+    p->zfile_fd = -1;
+    p->writer = NULL;
+
+    if(NULL != p->stats_file) {
+      /* Statistik schreiben */
+      sql_stats_write(p, p->stats_file);
+    } /* if(NULL != p->stats_file) */
   } /* if(NULL == p->out) */
 }
 
+void sql_table_begin_range(struct sql_table *p, size_t begin)
+{
+  sql_check_nullptr(p);
+
+  p->ranges = (struct sql_range*)sql_xrealloc(p->ranges, (1 + p->num_ranges) * sizeof(struct sql_range));
+  struct sql_range *r = p->ranges + p->num_ranges;
+  p->num_ranges += 1;
+
+  /* Bis zum Ende des Bereichs wird der aktuelle Zeilenzähler gemerkt */
+  r->begin = begin;
+  r->end = begin;
+  r->rows = p->rows;
+}
+
+void sql_table_end_range(struct sql_table *p, size_t end)
+{
+  sql_check_nullptr(p);
+
+  if(0 == p->num_ranges) {
+    /* Es wurde kein Bereich begonnen */
+    sql_debug("Table `%s' has no open range!", p->name);
+    return;
+  } /* if(0 == p->num_ranges) */
+
+  struct sql_range *r = p->ranges + p->num_ranges - 1;
+  r->end = end;
+  r->rows = p->rows - r->rows;
+}
+
 void sql_table_del_sibbling(struct sql_table *p)
 {
   sql_check_nullptr(p);
@@ -22,6 +22,7 @@
  */
 
 #include "sql.h"
+#include <errno.h>
 #include <string.h>
 
 int sql_be_quiet = 0;
@@ -36,6 +37,16 @@ void *sql_xmalloc(size_t s)
   return ptr;
 }
 
+void *sql_xrealloc(void *p, size_t s)
+{
+  void *ptr = NULL;
+  if((0 != s) && (NULL == (ptr = realloc(p, s)))) {
+    /* Programmabbruch, da der Speicher nicht allokiert werden konnte! */
+    sql_die("Could not reallocate %zu bytes!", s);
+  } /* if ...realloc ... */
+  return ptr;
+}
+
 void sql_xfree(void *p)
 {
   if(NULL != p) {
@@ -56,3 +67,90 @@ char *sql_xstrdup(const char *s)
     return cpy;
   } /* if(NULL == s) */
 }
+
+size_t sql_parse_count(const char *opt, const char *s, size_t min, size_t max)
+{
+  sql_check_nullptr(opt);
+  sql_check_nullptr(s);
+
+  /* strtoull() würde ein Minus stillschweigend umrechnen */
+  char *end = NULL;
+  errno = 0;
+  const unsigned long long x = (NULL == strchr(s, '-')) ? strtoull(s, &end, 10) : 0;
+  if((NULL == end) || (end == s) || (0 != *end) || (ERANGE == errno) || (min > x) || (max < x)) {
+    /* Programmabbruch, da der Wert nicht zur Option passt! */
+    sql_die("Invalid value `%s' for option `%s'! Expected a number from %zu to %zu.", s, opt, min, max);
+  } /* if ... */
+  return (size_t)x;
+}
+
+size_t sql_unescape(char *dst, const char *src, size_t n)
+{
+  char *it = dst;
+  const char *end = src + n;
+
+  while(src != end) {
+    const char *q = src;
+    /* Bis zum nächsten Sonderzeichen am Stück kopieren */
+    for(; (q != end) && ('\\' != *q) && ('\'' != *q); q += 1);
+    memcpy(it, src, q - src);
+    it += q - src;
+    src = q;
+
+    if(src == end) {
+      break;
+    } else if('\'' == *src) {
+      /* '' steht für ' */
+      *it++ = '\'';
+      src += ('\'' == src[1]) ? 2 : 1;
+      continue;
+    } else if(src + 1 == end) {
+      /* Einzelner Backslash am Ende */
+      *it++ = *src++;
+      continue;
+    } /* if ... */
+
+    switch(src[1]) {
+      case '0': *it++ = '\0';   break;
+      case 'b': *it++ = '\b';   break;
+      case 'n': *it++ = '\n';   break;
+      case 'r': *it++ = '\r';   break;
+      case 't': *it++ = '\t';   break;
+      case 'Z': *it++ = '\032'; break;
+      case '%':
+      case '_':
+        /* Bleiben wie bei MySQL maskiert */
+        *it++ = '\\';
+        *it++ = src[1];
+        break;
+      default:
+        *it++ = src[1];
+    } /* switch(src[1]) */
+    src += 2;
+  } /* while ... */
+
+  return it - dst;
+}
+
+static int sql_hex_digit(char c)
+{
+  return ('9' >= c) ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+size_t sql_unhex(char *dst, const char *src, size_t n)
+{
+  char *it = dst;
+  size_t i = 0;
+
+  if(0 != (n % 2)) {
+    /* Ungerade Anzahl: die erste Ziffer steht allein */
+    *it++ = (char)sql_hex_digit(src[0]);
+    i = 1;
+  } /* if(0 != (n % 2)) */
+
+  for(; i < n; i += 2) {
+    *it++ = (char)((sql_hex_digit(src[i]) << 4) | sql_hex_digit(src[i + 1]));
+  } /* for ... */
+
+  return it - dst;
+}
@@ -0,0 +1,731 @@
+/* The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 rbnn
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "sql.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef SQL_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif /* SQL_IO_URING */
+
+/* Ausgabe mit verzögertem Schreiben (write-behind):
+ * Jede Datei füllt einen eigenen, ausgerichteten Puffer. Volle Puffer werden
+ * über io_uring an ihren Offset geschrieben; ein Thread sammelt die
+ * Rückmeldungen ein. Im Ring sind nie mehr Aufträge als er Einträge hat,
+ * weitere warten in der Warteschlange des Pools. Eingereicht wird erst nach
+ * dem Entsperren. Steht io_uring nicht zur Verfügung, schreibt ein
+ * Thread-Pool die Puffer mit pwrite(). Alle Puffer sind gezählt: Sind alle
+ * vergeben, wartet der Parser, bis ein Puffer auf der Platte ist. Beim
+ * Entsperren gibt eine Tabelle ihren angefangenen Puffer ab.
+ */
+
+#define SQL_WRITER_ALIGN  4096
+
+struct sql_writer_buffer {
+  char                     *data;
+  size_t                    used;
+  size_t                    done;
+  off_t                     offset;
+  struct iovec              iov;
+  struct sql_writer        *owner;
+  struct sql_writer_buffer *next;
+}; /* struct sql_writer_buffer */
+
+struct sql_writer {
+  int                       fd;
+  int                       direct;
+  int                       error;
+  off_t                     offset;
+  size_t                    pending;
+  struct sql_writer_buffer *current;
+}; /* struct sql_writer */
+
+#ifdef SQL_IO_URING
+struct sql_writer_ring {
+  int                  fd;
+  char                *sq;
+  char                *cq;
+  size_t               sq_size;
+  size_t               cq_size;
+  struct io_uring_sqe *sqes;
+  size_t               sqes_size;
+  unsigned            *sq_head;
+  unsigned            *sq_tail;
+  unsigned            *sq_mask;
+  unsigned            *cq_head;
+  unsigned            *cq_tail;
+  unsigned            *cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned             entries;
+  unsigned             in_flight;
+}; /* struct sql_writer_ring */
+#endif /* SQL_IO_URING */
+
+static struct {
+  pthread_mutex_t           lock;
+  pthread_cond_t            has_job;
+  pthread_cond_t            has_done;
+  pthread_t                *threads;
+  size_t                    num_threads;
+  size_t                    buffer_size;
+  size_t                    num_buffers;
+  size_t                    max_buffers;
+  size_t                    num_jobs;
+  int                       direct;
+  int                       shutdown;
+  int                       uring;
+  struct sql_writer_buffer *free_buffers;
+  struct sql_writer_buffer *first_job;
+  struct sql_writer_buffer *last_job;
+  #ifdef SQL_IO_URING
+  struct sql_writer_ring    ring;
+  #endif /* SQL_IO_URING */
+} sql_writer_pool = {
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  NULL, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL
+};
+
+static struct sql_writer_buffer *sql_writer_buffer_new(void)
+{
+  struct sql_writer_buffer *buf = (struct sql_writer_buffer*)sql_xmalloc(sizeof(struct sql_writer_buffer));
+  if(0 != posix_memalign((void**)&buf->data, SQL_WRITER_ALIGN, sql_writer_pool.buffer_size)) {
+    /* Programmabbruch, da der Speicher nicht allokiert werden konnte! */
+    sql_die("Could not allocate %zu bytes!", sql_writer_pool.buffer_size);
+  } /* if(0 != posix_memalign ... ) */
+  buf->used = 0;
+  buf->done = 0;
+  buf->offset = 0;
+  buf->owner = NULL;
+  buf->next = NULL;
+  return buf;
+}
+
+static void sql_writer_buffer_free(struct sql_writer_buffer *p)
+{
+  if(NULL != p) {
+    sql_xfree(p->data);
+    sql_xfree(p);
+  } /* if(NULL != p) */
+}
+
+static int sql_writer_pwrite(int fd, const char *data, size_t n, off_t offset)
+{
+  while(0 < n) {
+    const ssize_t l = pwrite(fd, data, n, offset);
+    if(0 > l) {
+      if(EINTR == errno) {
+        /* Nochmal versuchen */
+        continue;
+      } /* if(EINTR == errno) */
+      return errno;
+    } /* if(0 > l) */
+    data += l;
+    offset += l;
+    n -= (size_t)l;
+  } /* while ... */
+  return 0;
+}
+
+/* Ein Puffer ist geschrieben (mit gesperrtem Pool). */
+static void sql_writer_finish(struct sql_writer_buffer *job, int error)
+{
+  if(0 != error) {
+    /* Der Fehler wird beim Schließen gemeldet */
+    job->owner->error = error;
+  } /* if(0 != error) */
+  job->owner->pending -= 1;
+  job->owner = NULL;
+  job->used = 0;
+  job->next = sql_writer_pool.free_buffers;
+  sql_writer_pool.free_buffers = job;
+  sql_writer_pool.num_jobs -= 1;
+  pthread_cond_broadcast(&sql_writer_pool.has_done);
+}
+
+#ifdef SQL_IO_URING
+static int sql_writer_ring_enter(unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, sql_writer_pool.ring.fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sql_writer_ring_init(unsigned entries)
+{
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  if(0 > (r->fd = (int)syscall(__NR_io_uring_setup, entries, &params))) {
+    /* Kernel ohne io_uring oder durch seccomp gesperrt */
+    sql_debug("Could not set up io_uring! (Error: %m)");
+    return 0;
+  } /* if(0 > ... io_uring_setup ... ) */
+
+  r->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  r->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  if(params.features & IORING_FEAT_SINGLE_MMAP) {
+    /* Beide Ringe liegen in einer Abbildung */
+    r->sq_size = (r->sq_size < r->cq_size) ? r->cq_size : r->sq_size;
+    r->cq_size = 0;
+  } /* if ... IORING_FEAT_SINGLE_MMAP ... */
+
+  r->sq = (char*)mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  r->cq = (0 == r->cq_size) ? r->sq : (char*)mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+  r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if((MAP_FAILED == r->sq) || (MAP_FAILED == r->cq) || (MAP_FAILED == (void*)r->sqes)) {
+    sql_debug("Could not map io_uring! (Error: %m)");
+    if(MAP_FAILED != r->sq) {
+      munmap(r->sq, r->sq_size);
+    } /* if ... */
+    if((0 < r->cq_size) && (MAP_FAILED != r->cq)) {
+      munmap(r->cq, r->cq_size);
+    } /* if ... */
+    if(MAP_FAILED != (void*)r->sqes) {
+      munmap(r->sqes, r->sqes_size);
+    } /* if ... */
+    close(r->fd);
+    return 0;
+  } /* if ... MAP_FAILED ... */
+
+  r->sq_head = (unsigned*)(r->sq + params.sq_off.head);
+  r->sq_tail = (unsigned*)(r->sq + params.sq_off.tail);
+  r->sq_mask = (unsigned*)(r->sq + params.sq_off.ring_mask);
+  r->cq_head = (unsigned*)(r->cq + params.cq_off.head);
+  r->cq_tail = (unsigned*)(r->cq + params.cq_off.tail);
+  r->cq_mask = (unsigned*)(r->cq + params.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe*)(r->cq + params.cq_off.cqes);
+  r->entries = params.sq_entries;
+  r->in_flight = 0;
+
+  /* Jeder Eintrag des Rings verweist fest auf sein SQE */
+  unsigned *array = (unsigned*)(r->sq + params.sq_off.array);
+  unsigned i = 0;
+  for(; i < params.sq_entries; i += 1) {
+    array[i] = i;
+  } /* for ... */
+  return 1;
+}
+
+static void sql_writer_ring_destroy(void)
+{
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+  munmap(r->sqes, r->sqes_size);
+  if(0 < r->cq_size) {
+    munmap(r->cq, r->cq_size);
+  } /* if(0 < r->cq_size) */
+  munmap(r->sq, r->sq_size);
+  close(r->fd);
+}
+
+/* Trägt einen Schreibauftrag in den Ring ein (mit gesperrtem Pool). Ohne
+ * JOB wird ein NOP eingetragen, der den Thread beendet. Eingereicht wird er
+ * mit sql_writer_ring_flush().
+ */
+static void sql_writer_ring_prepare(struct sql_writer_buffer *job)
+{
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+  const unsigned tail = *r->sq_tail;
+  struct io_uring_sqe *sqe = r->sqes + (tail & *r->sq_mask);
+
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  if(NULL == job) {
+    sqe->opcode = IORING_OP_NOP;
+  } else {
+    /* WRITEV gibt es seit dem ersten Kernel mit io_uring */
+    job->iov.iov_base = job->data + job->done;
+    job->iov.iov_len = job->used - job->done;
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = job->owner->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&job->iov;
+    sqe->len = 1;
+    sqe->off = (uint64_t)(job->offset + job->done);
+  } /* if(NULL == job) */
+  sqe->user_data = (uint64_t)(uintptr_t)job;
+  __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Trägt Aufträge aus der Warteschlange ein, solange der Ring Platz hat (mit
+ * gesperrtem Pool).
+ */
+static void sql_writer_ring_fill(void)
+{
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+  while((NULL != sql_writer_pool.first_job) && (r->in_flight < r->entries)) {
+    struct sql_writer_buffer *job = sql_writer_pool.first_job;
+    sql_writer_pool.first_job = job->next;
+    if(NULL == sql_writer_pool.first_job) {
+      sql_writer_pool.last_job = NULL;
+    } /* if(NULL == ... first_job) */
+    job->next = NULL;
+    r->in_flight += 1;
+    sql_writer_ring_prepare(job);
+  } /* while ... */
+}
+
+/* Reicht alle eingetragenen Aufträge ein (ohne Sperre). Da nie mehr Aufträge
+ * unterwegs sind als der Ring fasst, läuft die Completion-Queue nicht über;
+ * ein vorübergehendes EAGAIN wird wiederholt, ohne den Pool zu blockieren.
+ */
+static void sql_writer_ring_flush(void)
+{
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+  for(;;) {
+    const unsigned n = __atomic_load_n(r->sq_tail, __ATOMIC_ACQUIRE) - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if(0 == n) {
+      /* Alles eingereicht */
+      return;
+    } else if(0 <= sql_writer_ring_enter(n, 0, 0)) {
+      continue;
+    } else if((EINTR != errno) && (EAGAIN != errno) && (EBUSY != errno)) {
+      /* Programmabbruch, da der Auftrag nicht eingereicht werden kann! */
+      sql_die("Could not submit write to io_uring! (Error: %m)");
+    } /* if ... */
+    sched_yield();
+  } /* for ... */
+}
+
+static void *sql_writer_ring_thread(void *arg)
+{
+  (void)arg;
+  struct sql_writer_ring *r = &sql_writer_pool.ring;
+
+  for(;;) {
+    const unsigned head = *r->cq_head;
+    if(head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+      /* Auf die nächste Rückmeldung warten */
+      if((0 > sql_writer_ring_enter(0, 1, IORING_ENTER_GETEVENTS)) && (EINTR != errno)) {
+        sql_die("Could not wait for io_uring! (Error: %m)");
+      } /* if ... */
+      continue;
+    } /* if ... */
+
+    const struct io_uring_cqe *cqe = r->cqes + (head & *r->cq_mask);
+    struct sql_writer_buffer *job = (struct sql_writer_buffer*)(uintptr_t)cqe->user_data;
+    const int res = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    if(NULL == job) {
+      /* Der NOP beendet den Thread */
+      break;
+    } /* if(NULL == job) */
+
+    /* Ein erneut eingereichter Auftrag behält seinen Platz im Ring */
+    pthread_mutex_lock(&sql_writer_pool.lock);
+    if((-EINTR == res) || (-EAGAIN == res)) {
+      sql_writer_ring_prepare(job);
+    } else if((0 < res) && (job->used > (job->done += (size_t)res))) {
+      /* Kurz geschrieben: Rest erneut einreichen */
+      sql_writer_ring_prepare(job);
+    } else {
+      /* Der Platz im Ring wird für den nächsten Auftrag frei */
+      r->in_flight -= 1;
+      if(0 > res) {
+        sql_writer_finish(job, -res);
+      } else if(0 == res) {
+        sql_writer_finish(job, EIO);
+      } else {
+        sql_writer_finish(job, 0);
+      } /* if ... */
+      sql_writer_ring_fill();
+    } /* if ... */
+    pthread_mutex_unlock(&sql_writer_pool.lock);
+    sql_writer_ring_flush();
+  } /* for ... */
+  return NULL;
+}
+#endif /* SQL_IO_URING */
+
+static void *sql_writer_thread(void *arg)
+{
+  (void)arg;
+  pthread_mutex_lock(&sql_writer_pool.lock);
+  for(;;) {
+    while((NULL == sql_writer_pool.first_job) && !sql_writer_pool.shutdown) {
+      pthread_cond_wait(&sql_writer_pool.has_job, &sql_writer_pool.lock);
+    } /* while ... */
+
+    struct sql_writer_buffer *job = sql_writer_pool.first_job;
+    if(NULL == job) {
+      /* Der Pool wird beendet */
+      break;
+    } /* if(NULL == job) */
+
+    sql_writer_pool.first_job = job->next;
+    if(NULL == sql_writer_pool.first_job) {
+      sql_writer_pool.last_job = NULL;
+    } /* if(NULL == ... first_job) */
+    pthread_mutex_unlock(&sql_writer_pool.lock);
+
+    const int error = sql_writer_pwrite(job->owner->fd, job->data, job->used, job->offset);
+
+    pthread_mutex_lock(&sql_writer_pool.lock);
+    sql_writer_finish(job, error);
+  } /* for ... */
+  pthread_mutex_unlock(&sql_writer_pool.lock);
+  return NULL;
+}
+
+/* Übergibt den aktuellen Puffer zum Schreiben (mit gesperrtem Pool). */
+static void sql_writer_enqueue(struct sql_writer *p)
+{
+  struct sql_writer_buffer *job = p->current;
+  p->current = NULL;
+  job->owner = p;
+  job->offset = p->offset;
+  job->done = 0;
+  job->next = NULL;
+  p->offset += job->used;
+  p->pending += 1;
+  sql_writer_pool.num_jobs += 1;
+
+  if(NULL == sql_writer_pool.last_job) {
+    sql_writer_pool.first_job = job;
+  } else {
+    sql_writer_pool.last_job->next = job;
+  } /* if(NULL == ... last_job) */
+  sql_writer_pool.last_job = job;
+
+  #ifdef SQL_IO_URING
+  if(sql_writer_pool.uring) {
+    sql_writer_ring_fill();
+    return;
+  } /* if(sql_writer_pool.uring) */
+  #endif /* SQL_IO_URING */
+  pthread_cond_signal(&sql_writer_pool.has_job);
+}
+
+/* Reicht nach dem Entsperren ein, was sql_writer_enqueue() eingetragen hat. */
+static void sql_writer_submit(void)
+{
+  #ifdef SQL_IO_URING
+  if(sql_writer_pool.uring) {
+    sql_writer_ring_flush();
+  } /* if(sql_writer_pool.uring) */
+  #endif /* SQL_IO_URING */
+}
+
+/* Holt einen freien Puffer oder wartet, bis einer geschrieben ist (mit
+ * gesperrtem Pool). Liefert NULL, wenn ein neuer Puffer angelegt werden
+ * soll; er ist dann bereits gezählt.
+ */
+static struct sql_writer_buffer *sql_writer_take_buffer(void)
+{
+  while((NULL == sql_writer_pool.free_buffers) && (sql_writer_pool.num_buffers >= sql_writer_pool.max_buffers) && (0 < sql_writer_pool.num_jobs)) {
+    pthread_cond_wait(&sql_writer_pool.has_done, &sql_writer_pool.lock);
+  } /* while ... */
+
+  struct sql_writer_buffer *buf = sql_writer_pool.free_buffers;
+  if(NULL != buf) {
+    sql_writer_pool.free_buffers = buf->next;
+    buf->next = NULL;
+    return buf;
+  } /* if(NULL != buf) */
+
+  if(sql_writer_pool.num_buffers >= sql_writer_pool.max_buffers) {
+    /* Alle Puffer gehören gesperrten Tabellen, keiner kommt zurück */
+    sql_debug("More tables are being written than write buffers are allowed!");
+  } /* if ... */
+  sql_writer_pool.num_buffers += 1;
+  return NULL;
+}
+
+static void sql_writer_acquire(struct sql_writer *p)
+{
+  pthread_mutex_lock(&sql_writer_pool.lock);
+  struct sql_writer_buffer *buf = sql_writer_take_buffer();
+  pthread_mutex_unlock(&sql_writer_pool.lock);
+
+  p->current = (NULL != buf) ? buf : sql_writer_buffer_new();
+}
+
+static ssize_t sql_writer_write(void *cookie, const char *buf, size_t size)
+{
+  struct sql_writer *p = (struct sql_writer*)cookie;
+  size_t n = size;
+
+  if(0 != p->error) {
+    /* Ein früherer Schreibvorgang ist fehlgeschlagen */
+    errno = p->error;
+    return -1;
+  } /* if(0 != p->error) */
+
+  while(0 < n) {
+    if(NULL == p->current) {
+      /* Der Puffer wird erst beim Schreiben geholt */
+      sql_writer_acquire(p);
+    } /* if(NULL == p->current) */
+
+    struct sql_writer_buffer *cur = p->current;
+    size_t l = sql_writer_pool.buffer_size - cur->used;
+    if(l > n) {
+      l = n;
+    } /* if(l > n) */
+
+    memcpy(cur->data + cur->used, buf, l);
+    cur->used += l;
+    buf += l;
+    n -= l;
+
+    if(sql_writer_pool.buffer_size == cur->used) {
+      /* Der Puffer ist voll */
+      pthread_mutex_lock(&sql_writer_pool.lock);
+      sql_writer_enqueue(p);
+      pthread_mutex_unlock(&sql_writer_pool.lock);
+      sql_writer_submit();
+    } /* if ... */
+  } /* while ... */
+
+  return (ssize_t)size;
+}
+
+static int sql_writer_close(void *cookie)
+{
+  struct sql_writer *p = (struct sql_writer*)cookie;
+
+  /* Auf alle ausstehenden Puffer warten */
+  pthread_mutex_lock(&sql_writer_pool.lock);
+  while(0 < p->pending) {
+    pthread_cond_wait(&sql_writer_pool.has_done, &sql_writer_pool.lock);
+  } /* while ... */
+  pthread_mutex_unlock(&sql_writer_pool.lock);
+
+  int error = p->error;
+  struct sql_writer_buffer *cur = p->current;
+  if((0 == error) && (NULL != cur) && (0 < cur->used)) {
+    if(p->direct) {
+      /* Der Rest ist nicht ausgerichtet und wird ohne O_DIRECT geschrieben */
+      fcntl(p->fd, F_SETFL, fcntl(p->fd, F_GETFL) & ~O_DIRECT);
+    } /* if(p->direct) */
+    error = sql_writer_pwrite(p->fd, cur->data, cur->used, p->offset);
+  } /* if ... */
+
+  if(NULL != cur) {
+    pthread_mutex_lock(&sql_writer_pool.lock);
+    cur->used = 0;
+    cur->next = sql_writer_pool.free_buffers;
+    sql_writer_pool.free_buffers = cur;
+    pthread_cond_broadcast(&sql_writer_pool.has_done);
+    pthread_mutex_unlock(&sql_writer_pool.lock);
+  } /* if(NULL != cur) */
+
+  if((0 != close(p->fd)) && (0 == error)) {
+    error = errno;
+  } /* if ... close ... */
+  sql_xfree(p);
+
+  if(0 != error) {
+    errno = error;
+    return -1;
+  } /* if(0 != error) */
+  return 0;
+}
+
+void sql_writer_init(size_t threads, size_t buffers, size_t buffer_size, int direct)
+{
+  sql_assert(0 < threads);
+  sql_assert(NULL == sql_writer_pool.threads);
+
+  /* Die Puffergröße muss für O_DIRECT ausgerichtet sein */
+  buffer_size = (buffer_size + SQL_WRITER_ALIGN - 1) / SQL_WRITER_ALIGN * SQL_WRITER_ALIGN;
+  sql_writer_pool.buffer_size = (0 < buffer_size) ? buffer_size : SQL_WRITER_ALIGN;
+  sql_writer_pool.max_buffers = (0 < buffers) ? buffers : 1;
+  sql_writer_pool.num_buffers = 0;
+  sql_writer_pool.num_jobs = 0;
+  sql_writer_pool.direct = direct;
+  sql_writer_pool.shutdown = 0;
+  sql_writer_pool.uring = 0;
+
+  #ifdef SQL_IO_URING
+  /* Weitere Aufträge warten in der Warteschlange auf einen Platz im Ring */
+  const size_t entries = (4096 < sql_writer_pool.max_buffers) ? 4096 : sql_writer_pool.max_buffers;
+  if(sql_writer_ring_init((unsigned)entries)) {
+    sql_writer_pool.uring = 1;
+    sql_writer_pool.num_threads = 1;
+    sql_writer_pool.threads = (pthread_t*)sql_xmalloc(sizeof(pthread_t));
+    if(0 != pthread_create(sql_writer_pool.threads, NULL, sql_writer_ring_thread, NULL)) {
+      /* Programmabbruch, da der Thread nicht gestartet werden konnte! */
+      sql_die("Could not start writer thread!");
+    } /* if(0 != pthread_create ... ) */
+    sql_debug("Writing asynchronously with io_uring.");
+    return;
+  } /* if(sql_writer_ring_init ... ) */
+  #endif /* SQL_IO_URING */
+
+  sql_writer_pool.num_threads = threads;
+  sql_writer_pool.threads = (pthread_t*)sql_xmalloc(threads * sizeof(pthread_t));
+
+  size_t i = 0;
+  for(; i < threads; i += 1) {
+    if(0 != pthread_create(sql_writer_pool.threads + i, NULL, sql_writer_thread, NULL)) {
+      /* Programmabbruch, da der Thread nicht gestartet werden konnte! */
+      sql_die("Could not start writer thread!");
+    } /* if(0 != pthread_create ... ) */
+  } /* for ... */
+  sql_debug("Started %zu writer threads.", threads);
+}
+
+void sql_writer_shutdown(void)
+{
+  if(NULL == sql_writer_pool.threads) {
+    /* Der Pool wurde nicht gestartet */
+    return;
+  } /* if(NULL == ... threads) */
+
+  pthread_mutex_lock(&sql_writer_pool.lock);
+  sql_writer_pool.shutdown = 1;
+  #ifdef SQL_IO_URING
+  if(sql_writer_pool.uring) {
+    /* Alle Dateien sind geschlossen, der NOP kommt als Letztes */
+    sql_writer_ring_prepare(NULL);
+  } /* if(sql_writer_pool.uring) */
+  #endif /* SQL_IO_URING */
+  pthread_cond_broadcast(&sql_writer_pool.has_job);
+  pthread_mutex_unlock(&sql_writer_pool.lock);
+  sql_writer_submit();
+
+  size_t i = 0;
+  for(; i < sql_writer_pool.num_threads; i += 1) {
+    pthread_join(sql_writer_pool.threads[i], NULL);
+  } /* for ... */
+  sql_xfree(sql_writer_pool.threads);
+  sql_writer_pool.threads = NULL;
+  sql_writer_pool.num_threads = 0;
+
+  #ifdef SQL_IO_URING
+  if(sql_writer_pool.uring) {
+    sql_writer_ring_destroy();
+    sql_writer_pool.uring = 0;
+  } /* if(sql_writer_pool.uring) */
+  #endif /* SQL_IO_URING */
+
+  while(NULL != sql_writer_pool.free_buffers) {
+    struct sql_writer_buffer *it_next = sql_writer_pool.free_buffers->next;
+    sql_writer_buffer_free(sql_writer_pool.free_buffers);
+    sql_writer_pool.free_buffers = it_next;
+  } /* while ... */
+  sql_writer_pool.num_buffers = 0;
+}
+
+int sql_writer_enabled(void)
+{
+  return NULL != sql_writer_pool.threads;
+}
+
+FILE *sql_writer_open(const char *filename, const char *mode, struct sql_writer **writer)
+{
+  sql_check_nullptr(filename);
+  sql_check_nullptr(mode);
+  sql_check_nullptr(writer);
+  sql_assert(sql_writer_enabled());
+
+  const int append = ('a' == *mode);
+  const int flags = O_WRONLY | O_CREAT | (append ? 0 : O_TRUNC);
+  int direct = sql_writer_pool.direct;
+  int fd = -1;
+  *writer = NULL;
+
+  if(direct && (0 > (fd = open(filename, flags | O_DIRECT, 0666)))) {
+    /* Das Dateisystem unterstützt O_DIRECT womöglich nicht */
+    sql_debug("Could not open `%s' with O_DIRECT! (Error: %m)", filename);
+    direct = 0;
+  } /* if(direct ... ) */
+
+  if((0 > fd) && (0 > (fd = open(filename, flags, 0666)))) {
+    return NULL;
+  } /* if ... open ... */
+
+  struct stat st;
+  if((0 != fstat(fd, &st)) || !S_ISREG(st.st_mode)) {
+    /* Pipes und Geräte werden ohne Offsets gewöhnlich beschrieben */
+    if(direct) {
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    } /* if(direct) */
+    return fdopen(fd, mode);
+  } /* if ... S_ISREG ... */
+
+  struct sql_writer *p = (struct sql_writer*)sql_xmalloc(sizeof(struct sql_writer));
+  p->fd = fd;
+  p->error = 0;
+  p->pending = 0;
+  p->offset = append ? st.st_size : 0;
+  p->direct = direct;
+  p->current = NULL;
+
+  if(direct && (0 != (p->offset % SQL_WRITER_ALIGN))) {
+    /* Angehängte Daten wären nicht ausgerichtet */
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    p->direct = 0;
+  } /* if ... */
+
+  const cookie_io_functions_t cfunc = {
+    NULL,
+    sql_writer_write,
+    NULL,
+    sql_writer_close};
+  /* Angehängt wird über den Offset, nicht über den Modus */
+  FILE *out = NULL;
+  if(NULL == (out = fopencookie(p, "w", cfunc))) {
+    /* Fehler, da die Datei nicht geöffnet wurde! */
+    sql_writer_close(p);
+    return NULL;
+  } /* if(NULL == ...fopencookie(...)) */
+  *writer = p;
+  return out;
+}
+
+void sql_writer_release(struct sql_writer *p)
+{
+  sql_check_nullptr(p);
+
+  if(NULL == p->current) {
+    /* Nix weiter */
+    return;
+  } /* if(NULL == p->current) */
+
+  pthread_mutex_lock(&sql_writer_pool.lock);
+  if(0 < p->current->used) {
+    if(p->direct && (0 != (p->current->used % SQL_WRITER_ALIGN))) {
+      /* Alles nach dem angefangenen Puffer wäre nicht ausgerichtet */
+      fcntl(p->fd, F_SETFL, fcntl(p->fd, F_GETFL) & ~O_DIRECT);
+      p->direct = 0;
+    } /* if ... */
+    sql_writer_enqueue(p);
+  } else {
+    p->current->next = sql_writer_pool.free_buffers;
+    sql_writer_pool.free_buffers = p->current;
+    p->current = NULL;
+    pthread_cond_broadcast(&sql_writer_pool.has_done);
+  } /* if(0 < p->current->used) */
+  pthread_mutex_unlock(&sql_writer_pool.lock);
+  sql_writer_submit();
+}